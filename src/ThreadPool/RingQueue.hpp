@@ -0,0 +1,152 @@
+#ifndef __RING_QUEUE__
+#define __RING_QUEUE__
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+#include <stdlib.h>
+
+#include "src/utils/util.hpp"
+
+// 缓存行大小，用于填充，避免伪共享
+#define CACHE_LINE_SIZE 64
+
+// 无锁、有界的多生产者多消费者环形队列
+// 每个槽位带一个序号：序号等于入队位置时可写，等于入队位置+1时可读
+// 队列满时push返回false，由调用者决定如何处理（背压），队列不会无限增长
+template <typename T>
+class RingQueue
+{
+private:
+    struct alignas(CACHE_LINE_SIZE) Slot
+    {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    Slot *slots_;
+    size_t mask_;
+
+    // 生产者与消费者的位置各占一个缓存行
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_;
+
+    // 向上取整为2的幂
+    static size_t round_up_pow2(size_t n)
+    {
+        size_t cap = 2;
+        while (cap < n)
+            cap <<= 1;
+        return cap;
+    }
+
+public:
+    // 容量会被向上取整为2的幂
+    RingQueue(size_t capacity)
+        : mask_(round_up_pow2(capacity) - 1), enqueue_pos_(0), dequeue_pos_(0)
+    {
+        // 按缓存行对齐分配槽位
+        void *mem = NULL;
+        if (posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(Slot) * (mask_ + 1)) != 0)
+            UtilError::error_exit("ring queue alloc failed", false);
+
+        slots_ = static_cast<Slot *>(mem);
+        for (size_t i = 0; i <= mask_; i++)
+        {
+            new (&slots_[i]) Slot();
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~RingQueue()
+    {
+        for (size_t i = 0; i <= mask_; i++)
+            slots_[i].~Slot();
+        free(slots_);
+    }
+
+    // 禁用赋值与拷贝构造
+    RingQueue(const RingQueue &) = delete;
+    RingQueue(RingQueue &&) = delete;
+    RingQueue &operator=(const RingQueue &) = delete;
+    RingQueue &operator=(RingQueue &&) = delete;
+
+    size_t capacity() { return mask_ + 1; }
+
+    // 近似值，仅供参考
+    bool empty()
+    {
+        return enqueue_pos_.load(std::memory_order_acquire) ==
+               dequeue_pos_.load(std::memory_order_acquire);
+    }
+
+    // 队列满返回false
+    bool push(T &&t)
+    {
+        Slot *slot;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            // 槽位可写，抢占该位置
+            if (diff == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            // 槽位还未被消费，队列已满
+            else if (diff < 0)
+                return false;
+            // 被其他生产者抢先，重新读取位置
+            else
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+
+        slot->data = std::move(t);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool push(T &t)
+    {
+        T copy(t);
+        return push(std::move(copy));
+    }
+
+    // 返回是否成功，内容赋值在in中
+    bool pop(T &in)
+    {
+        Slot *slot;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot = &slots_[pos & mask_];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            // 槽位可读，抢占该位置
+            if (diff == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            // 槽位还未写入，队列为空
+            else if (diff < 0)
+                return false;
+            // 被其他消费者抢先，重新读取位置
+            else
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+
+        in = std::move(slot->data);
+        // 释放槽位给下一轮的生产者
+        slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif // __RING_QUEUE__
@@ -0,0 +1,83 @@
+#ifndef __STRAND__
+#define __STRAND__
+
+#include <mutex>
+#include <deque>
+#include <memory>
+
+#include "src/ThreadPool/ThreadPool.hpp"
+
+// 串行执行器，建立在线程池之上
+// 同一个Strand上的任务按提交顺序执行，且不会同时执行；不同Strand上的任务在线程池中并行
+// 任务排队而不是在锁上等待，因此不会让工作线程阻塞
+class Strand : public std::enable_shared_from_this<Strand>
+{
+private:
+    // 一次最多连续执行的任务数，超过后把剩下的任务重新放回线程池，避免一个Strand霸占工作线程
+    static const int MAX_TASKS_PER_RUN = 16;
+
+    ThreadPool *pool_;
+    std::mutex mutex_;
+    std::deque<Task> tasks_;
+    bool running_ = false; // 是否已经有一个run()在线程池中排队或执行
+
+public:
+    Strand(ThreadPool *pool) : pool_(pool) {}
+
+    // 禁用拷贝、赋值
+    Strand(const Strand &) = delete;
+    Strand &operator=(const Strand &) = delete;
+
+    // 任务入队，返回true表示调用者需要把run()送入线程池
+    // 供批量提交使用，一般直接用post()
+    bool enqueue(Task &task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.emplace_back(std::move(task));
+        if (running_)
+            return false;
+
+        running_ = true;
+        return true;
+    }
+
+    // 提交任务
+    void post(Task task)
+    {
+        if (enqueue(task))
+            schedule();
+    }
+
+    // 把run()送入线程池，任务持有Strand的共享指针，保证执行时Strand仍然存活
+    void schedule()
+    {
+        std::shared_ptr<Strand> self = shared_from_this();
+        pool_->post([self]()
+                    { self->run(); });
+    }
+
+    // 在工作线程中依次执行队列中的任务
+    void run()
+    {
+        Task task;
+        for (int i = 0; i < MAX_TASKS_PER_RUN; i++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (tasks_.empty())
+                {
+                    running_ = false;
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+
+        // 还有任务，让出工作线程，重新排队
+        schedule();
+    }
+};
+
+#endif // __STRAND__
@@ -0,0 +1,278 @@
+#ifndef __TASK__
+#define __TASK__
+
+#include <mutex>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include <stddef.h>
+
+// 只可移动的任务（void()），代替std::function<void()>
+// 小的可调用对象（比如捕获一两个指针的lambda）直接存放在内部缓冲区中，不需要分配内存
+// 超过缓冲区大小的可调用对象才会在堆上分配
+class Task
+{
+private:
+    // 内部缓冲区大小，加上ops_指针后整个Task恰好占一个缓存行
+    static const size_t INLINE_SIZE = 48;
+    typedef typename std::aligned_storage<INLINE_SIZE, alignof(max_align_t)>::type Storage;
+
+    // 每种可调用对象类型对应的操作表
+    struct Ops
+    {
+        void (*invoke)(Storage &);
+        void (*move)(Storage &dst, Storage &src); // 移动到dst并析构src
+        void (*destroy)(Storage &);
+        bool is_inline;
+    };
+
+    // 可调用对象直接存放在缓冲区中
+    template <typename F>
+    struct InlineOps
+    {
+        static F *get(Storage &s) { return reinterpret_cast<F *>(&s); }
+        static void invoke(Storage &s) { (*get(s))(); }
+        static void move(Storage &dst, Storage &src)
+        {
+            new (&dst) F(std::move(*get(src)));
+            get(src)->~F();
+        }
+        static void destroy(Storage &s) { get(s)->~F(); }
+        static const Ops *ops()
+        {
+            static const Ops o = {&invoke, &move, &destroy, true};
+            return &o;
+        }
+    };
+
+    // 缓冲区中只存放指向堆上可调用对象的指针
+    template <typename F>
+    struct HeapOps
+    {
+        static F *&get(Storage &s) { return *reinterpret_cast<F **>(&s); }
+        static void invoke(Storage &s) { (*get(s))(); }
+        static void move(Storage &dst, Storage &src)
+        {
+            new (&dst) F *(get(src));
+            get(src) = NULL;
+        }
+        static void destroy(Storage &s) { delete get(s); }
+        static const Ops *ops()
+        {
+            static const Ops o = {&invoke, &move, &destroy, false};
+            return &o;
+        }
+    };
+
+    // 能否放入内部缓冲区
+    template <typename F>
+    struct fits_inline
+    {
+        static const bool value = sizeof(F) <= INLINE_SIZE &&
+                                  alignof(F) <= alignof(Storage) &&
+                                  std::is_nothrow_move_constructible<F>::value;
+    };
+
+    Storage storage_;
+    const Ops *ops_ = NULL;
+
+    void reset()
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+            ops_ = NULL;
+        }
+    }
+
+    template <typename F>
+    void init(F &&f, std::true_type)
+    {
+        typedef typename std::decay<F>::type Fn;
+        new (&storage_) Fn(std::forward<F>(f));
+        ops_ = InlineOps<Fn>::ops();
+    }
+
+    template <typename F>
+    void init(F &&f, std::false_type)
+    {
+        typedef typename std::decay<F>::type Fn;
+        new (&storage_) Fn *(new Fn(std::forward<F>(f)));
+        ops_ = HeapOps<Fn>::ops();
+    }
+
+public:
+    Task() = default;
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f)
+    {
+        init(std::forward<F>(f), std::integral_constant<bool, fits_inline<typename std::decay<F>::type>::value>());
+    }
+
+    Task(Task &&other) noexcept
+    {
+        if (other.ops_)
+        {
+            other.ops_->move(storage_, other.storage_);
+            ops_ = other.ops_;
+            other.ops_ = NULL;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = NULL;
+            }
+        }
+        return *this;
+    }
+
+    ~Task() { reset(); }
+
+    // 禁用拷贝
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    explicit operator bool() const { return ops_ != NULL; }
+
+    // 可调用对象是否存放在内部缓冲区中（没有分配内存）
+    bool stored_inline() const { return ops_ && ops_->is_inline; }
+
+    void operator()() { ops_->invoke(storage_); }
+};
+
+template <typename R>
+class TaskPromise;
+
+// 不分配内存的future，结果直接存放在对象内部
+// 由调用者持有（通常在栈上），不可移动，在get()返回之前必须保持存活
+// 不传递异常，任务中抛出的异常会在工作线程中抛出
+template <typename R>
+class TaskFuture
+{
+private:
+    friend class TaskPromise<R>;
+
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type value_;
+    bool ready_ = false;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    template <typename V>
+    void set_value(V &&v)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        new (&value_) R(std::forward<V>(v));
+        ready_ = true;
+        cond_.notify_all();
+    }
+
+public:
+    TaskFuture() = default;
+    ~TaskFuture()
+    {
+        if (ready_)
+            reinterpret_cast<R *>(&value_)->~R();
+    }
+
+    // 禁用拷贝与移动，promise持有的是本对象的地址
+    TaskFuture(const TaskFuture &) = delete;
+    TaskFuture(TaskFuture &&) = delete;
+    TaskFuture &operator=(const TaskFuture &) = delete;
+    TaskFuture &operator=(TaskFuture &&) = delete;
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!ready_)
+            cond_.wait(lock);
+    }
+
+    // 等待并取出结果
+    R &get()
+    {
+        wait();
+        return *reinterpret_cast<R *>(&value_);
+    }
+};
+
+// void特化
+template <>
+class TaskFuture<void>
+{
+private:
+    friend class TaskPromise<void>;
+
+    bool ready_ = false;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    void set_value()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_ = true;
+        cond_.notify_all();
+    }
+
+public:
+    TaskFuture() = default;
+    TaskFuture(const TaskFuture &) = delete;
+    TaskFuture(TaskFuture &&) = delete;
+    TaskFuture &operator=(const TaskFuture &) = delete;
+    TaskFuture &operator=(TaskFuture &&) = delete;
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!ready_)
+            cond_.wait(lock);
+    }
+
+    void get() { wait(); }
+};
+
+// 与TaskFuture配对，只保存TaskFuture的地址，由任务持有
+template <typename R>
+class TaskPromise
+{
+private:
+    TaskFuture<R> *future_;
+
+public:
+    TaskPromise(TaskFuture<R> &future) : future_(&future) {}
+
+    // 运行函数并把结果写入future
+    template <typename F>
+    void run(F &f) { future_->set_value(f()); }
+};
+
+template <>
+class TaskPromise<void>
+{
+private:
+    TaskFuture<void> *future_;
+
+public:
+    TaskPromise(TaskFuture<void> &future) : future_(&future) {}
+
+    template <typename F>
+    void run(F &f)
+    {
+        f();
+        future_->set_value();
+    }
+};
+
+#endif // __TASK__
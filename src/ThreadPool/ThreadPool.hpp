@@ -2,14 +2,21 @@
 #define __THREAD_POOL__
 
 #include <mutex>
+#include <deque>
 #include <queue>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <future>
 #include <utility>
+#include <algorithm>
 #include <functional>
 
 #include "src/log/Log.hpp"
+#include "src/ThreadPool/RingQueue.hpp"
+#include "src/ThreadPool/Task.hpp"
 
 // 适用于多线程的原子性队列
 template <typename T>
@@ -61,10 +68,25 @@ public:
     }
 };
 
+// 线程池的任务分发模式
+enum ThreadPoolMode : int8_t
+{
+    SharedQueue, // 所有工作线程共用一个任务队列
+    WorkStealing // 每个工作线程拥有自己的双端队列，空闲时从其他线程窃取任务
+};
+
 // 线程池
 class ThreadPool
 {
 private:
+    // 工作窃取模式下，每个工作线程私有的双端队列
+    // 自己从队尾取（后进先出，局部性更好），其他线程从队头窃取
+    struct WorkerDeque
+    {
+        std::deque<Task> tasks;
+        std::mutex mutex;
+    };
+
     // 工作线程类
     class ThreadWorker
     {
@@ -79,54 +101,246 @@ private:
 
         void operator()()
         {
-            std::function<void()> func; // 需要运行的函数
-            bool pop_queue_success;     // 是否成功从队列中取出内容
+            // 记录当前线程所属的线程池，用于判断submit是否来自工作线程
+            current_pool() = thread_pool_;
+            current_worker_id() = worker_id_;
+
+            Task func; // 需要运行的函数
 
             while (true)
             {
-                // 取任务
+                // 取任务，成功则执行；忙等模式下睡眠前先自旋一段时间
+                if (thread_pool_->take_task(worker_id_, func) || thread_pool_->spin_take(worker_id_, func))
                 {
-                    std::unique_lock<std::mutex> lock(thread_pool_->mutex_);
-
-                    // 等待条件变量
-                    while (!thread_pool_->shutdown_ && thread_pool_->task_queue_.empty())
-                    {
-                        Log::debug("worker" + std::to_string(worker_id_) + " start waiting for task");
-                        thread_pool_->cond_.wait(lock);
-                    }
-
-                    if (thread_pool_->shutdown_)
-                        break;
-
-                    // 从线程池的任务队列中取出任务
-                    pop_queue_success = thread_pool_->task_queue_.pop(func);
+                    func();
+                    Log::debug("worker" + std::to_string(worker_id_) + " finish task");
+                    continue;
                 }
 
-                // 执行任务
-                assert(pop_queue_success);
-                if (pop_queue_success)
-                    func();
+                // 没有任务，睡眠
+                std::unique_lock<std::mutex> lock(thread_pool_->mutex_);
+                thread_pool_->sleeping_workers_++;
+                while (!thread_pool_->shutdown_ && thread_pool_->pending_tasks_.load() <= 0)
+                {
+                    Log::debug("worker" + std::to_string(worker_id_) + " start waiting for task");
+                    thread_pool_->cond_.wait(lock);
+                }
+                thread_pool_->sleeping_workers_--;
 
-                Log::debug("worker" + std::to_string(worker_id_) + " finish task");
+                if (thread_pool_->shutdown_)
+                    break;
             }
         }
     };
 
-    bool shutdown_ = false;                         // 停止
-    AtomicQueue<std::function<void()>> task_queue_; // 任务队列
-    std::vector<std::thread> threads_;              // 线程列表
+    bool shutdown_ = false;                        // 停止
+    const ThreadPoolMode mode_;                    // 任务分发模式
+    RingQueue<Task> task_queue_;       // 任务队列（共享队列模式）
+    std::vector<std::thread> threads_; // 线程列表
+
+    // 工作窃取模式用
+    std::vector<std::unique_ptr<WorkerDeque>> deques_; // 每个工作线程的队列
+    std::atomic<unsigned int> next_deque_{0};           // 非工作线程提交时轮询的下标
+
+    std::atomic<int> pending_tasks_{0};    // 队列中的任务总数
+    const int spin_us_;                    // 忙等模式：没有任务时睡眠前自旋的微秒数，0表示直接睡眠
+    std::atomic<int> sleeping_workers_{0}; // 正在睡眠的工作线程数
 
     std::mutex mutex_;
     std::condition_variable cond_;
 
+    // 当前线程所属的线程池与工作线程编号，非工作线程为NULL与-1
+    static ThreadPool *&current_pool()
+    {
+        thread_local ThreadPool *pool = NULL;
+        return pool;
+    }
+    static int &current_worker_id()
+    {
+        thread_local int id = -1;
+        return id;
+    }
+
+    // 队列满时工作线程帮忙执行任务的嵌套层数，超过MAX_HELP_DEPTH后只等待，避免栈无限增长
+    static const int MAX_HELP_DEPTH = 4;
+    static int &help_depth()
+    {
+        thread_local int depth = 0;
+        return depth;
+    }
+
+    // 从自己的队列尾部取任务
+    bool pop_local(int id, Task &func)
+    {
+        WorkerDeque &dq = *deques_[id];
+        std::lock_guard<std::mutex> lock(dq.mutex);
+        if (dq.tasks.empty())
+            return false;
+
+        func = std::move(dq.tasks.back());
+        dq.tasks.pop_back();
+        return true;
+    }
+
+    // 从其他工作线程的队列头部窃取任务
+    bool steal(int id, Task &func)
+    {
+        int n = deques_.size();
+        for (int i = 1; i < n; i++)
+        {
+            WorkerDeque &dq = *deques_[(id + i) % n];
+
+            // 窃取时不等锁，被占用就换下一个
+            std::unique_lock<std::mutex> lock(dq.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || dq.tasks.empty())
+                continue;
+
+            func = std::move(dq.tasks.front());
+            dq.tasks.pop_front();
+            Log::debug("worker" + std::to_string(id) + " steal task from worker" + std::to_string((id + i) % n));
+            return true;
+        }
+        return false;
+    }
+
+    // 工作线程取任务
+    bool take_task(int id, Task &func)
+    {
+        bool success;
+        if (mode_ == ThreadPoolMode::WorkStealing)
+            success = pop_local(id, func) || steal(id, func);
+        else
+            success = task_queue_.pop(func);
+
+        if (success)
+            pending_tasks_--;
+        return success;
+    }
+
+    // 在spin_us_内反复检查队列，自旋中的线程不算睡眠，提交任务时不需要唤醒
+    bool spin_take(int id, Task &func)
+    {
+        if (spin_us_ <= 0)
+            return false;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_us_);
+        do
+        {
+            if (pending_tasks_.load() > 0 && take_task(id, func))
+                return true;
+            UtilSystem::cpu_relax();
+        } while (std::chrono::steady_clock::now() < deadline);
+        return false;
+    }
+
+    // 唤醒至多n个正在睡眠的线程，加锁保证不会错过正在进入睡眠的线程
+    void wake_workers(int n)
+    {
+        int sleeping = sleeping_workers_.load();
+        if (sleeping == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < std::min(n, sleeping); i++)
+            cond_.notify_one();
+    }
+
+    // 共享队列模式下入队，队列满时等待工作线程腾出空间
+    // 工作线程自己提交时一边等待一边执行队列头部的任务，避免所有工作线程互相等待
+    // 不想等待的调用者（比如事件循环）使用try_post()，自己决定队列满时怎么办
+    void enqueue_shared(Task &func)
+    {
+        if (task_queue_.push(std::move(func)))
+            return;
+
+        Log::warn("task queue is full, submitter is blocked");
+        int &depth = help_depth();
+        do
+        {
+            Task other;
+            if (current_pool() == this && depth < MAX_HELP_DEPTH && task_queue_.pop(other))
+            {
+                pending_tasks_--;
+                depth++;
+                other();
+                depth--;
+                continue;
+            }
+            wake_workers(1);
+            std::this_thread::yield();
+        } while (!task_queue_.push(std::move(func)));
+    }
+
+    // 工作窃取模式下选择队列：工作线程提交到自己的队列，其他线程轮询分配
+    WorkerDeque &select_deque()
+    {
+        int id = (current_pool() == this) ? current_worker_id()
+                                            : next_deque_++ % deques_.size();
+        return *deques_[id];
+    }
+
+    // 送入任务，并唤醒一个线程
+    void push_task(Task &func)
+    {
+        if (mode_ == ThreadPoolMode::WorkStealing)
+        {
+            WorkerDeque &dq = select_deque();
+            std::lock_guard<std::mutex> lock(dq.mutex);
+            dq.tasks.emplace_back(std::move(func));
+        }
+        else
+            enqueue_shared(func);
+
+        pending_tasks_++;
+        wake_workers(1);
+    }
+
+    // 批量送入任务，只同步一次，按任务数唤醒线程
+    void push_tasks(std::vector<Task> &tasks)
+    {
+        int queued = tasks.size();
+        if (mode_ == ThreadPoolMode::WorkStealing)
+        {
+            // 整批放入同一个队列，只加一次锁，其他线程通过窃取分担
+            WorkerDeque &dq = select_deque();
+            std::lock_guard<std::mutex> lock(dq.mutex);
+            for (auto &task : tasks)
+                dq.tasks.emplace_back(std::move(task));
+        }
+        else
+        {
+            for (auto &task : tasks)
+                enqueue_shared(task);
+        }
+        tasks.clear();
+
+        pending_tasks_ += queued;
+        wake_workers(queued);
+    }
+
 public:
-    ThreadPool(int num_threads)
+    // queue_capacity为共享队列模式下任务队列的容量
+    // spin_us大于0时开启忙等模式，工作线程没有任务时先自旋spin_us微秒再睡眠，降低唤醒延迟
+    ThreadPool(int num_threads, ThreadPoolMode mode = ThreadPoolMode::SharedQueue, int queue_capacity = 1024, int spin_us = 0)
+        : mode_(mode), task_queue_(mode == ThreadPoolMode::SharedQueue ? queue_capacity : 1), spin_us_(spin_us)
     {
         if (num_threads <= 0)
         {
             std::string msg = "error threads num setting";
             UtilError::error_exit(msg, false);
         }
+        if (queue_capacity <= 0)
+            UtilError::error_exit("error task queue capacity setting", false);
+        if (spin_us < 0)
+            UtilError::error_exit("error pool spin setting", false);
+
+        // 工作窃取模式下每个线程一个队列
+        if (mode_ == ThreadPoolMode::WorkStealing)
+        {
+            deques_.resize(num_threads);
+            for (int i = 0; i < num_threads; i++)
+                deques_[i].reset(new WorkerDeque());
+        }
 
         // 初始化工作线程列表
         threads_.resize(num_threads);
@@ -148,6 +362,29 @@ public:
     ThreadPool &operator=(const ThreadPool &) = delete;
     ThreadPool &operator=(ThreadPool &&) = delete;
 
+    // 由配置文件中的thread_pool_mode得到分发模式，默认为共享队列
+    static ThreadPoolMode mode_from_config()
+    {
+        std::string mode = config::get("thread_pool_mode", "shared");
+        if (mode == "work_stealing")
+            return ThreadPoolMode::WorkStealing;
+        if (mode != "shared")
+            UtilError::error_exit("invalid thread_pool_mode \"" + mode + "\"", false);
+        return ThreadPoolMode::SharedQueue;
+    }
+
+    // 由配置文件中的task_queue_capacity得到任务队列容量
+    static int queue_capacity_from_config()
+    {
+        return atoi(config::get("task_queue_capacity", "1024").c_str());
+    }
+
+    // 由配置文件中的pool_spin_us得到工作线程的自旋时间，默认为0（不自旋）
+    static int spin_us_from_config()
+    {
+        return atoi(config::get("pool_spin_us", "0").c_str());
+    }
+
     // 停止
     void shutdown()
     {
@@ -179,24 +416,120 @@ public:
         // 函数的返回类型
         using retType = decltype(f(args...));
 
-        // 定义要执行的函数函数
-        std::function<retType()> func = std::bind(std::forward<Func>(f), std::forward<Args>(args)...);
+        // 将函数包在packaged_task中，这样packaged_task运行会返回相应的future
+        std::packaged_task<retType()> packaged(std::bind(std::forward<Func>(f), std::forward<Args>(args)...));
+        std::future<retType> future = packaged.get_future();
 
-        // 将函数包在packaged_task中，这样packaged_task运行会返回相应的future，把packaged_task包在共享指针中
-        auto task_ptr = std::make_shared<std::packaged_task<retType()>>(func);
+        // packaged_task只可移动，直接移入Task，不需要再包一层共享指针
+        Task task(std::move(packaged));
 
-        // 用void类型函数包裹上述函数，方便统一送入队列
-        std::function<void()> wrapper_func = [task_ptr]()
-        { (*task_ptr)(); };
+        // 送入任务队列，并唤醒一个线程
+        push_task(task);
 
-        // 送入任务队列
-        task_queue_.push(wrapper_func);
+        // 返回future
+        return future;
+    }
+
+    // 向线程池增加一个任务，结果写入调用者持有的TaskFuture，不分配内存
+    // 调用者需要保证result在任务完成（result.get()返回）之前存活
+    template <typename Func, typename... Args>
+    void submit_to(TaskFuture<decltype(std::declval<Func>()(std::declval<Args>()...))> &result, Func &&f, Args &&...args)
+    {
+        using retType = decltype(f(args...));
+        using Bound = decltype(std::bind(std::forward<Func>(f), std::forward<Args>(args)...));
 
-        // 唤醒一个线程
-        cond_.notify_one();
+        // 绑定参数的函数与promise
+        struct ResultTask
+        {
+            TaskPromise<retType> promise;
+            Bound func;
+            void operator()() { promise.run(func); }
+        };
 
-        // 返回future
-        return task_ptr->get_future();
+        Task task(ResultTask{TaskPromise<retType>(result), std::bind(std::forward<Func>(f), std::forward<Args>(args)...)});
+        push_task(task);
+    }
+
+    // 向线程池增加一个不需要返回值的任务，不创建future
+    template <typename Func>
+    void post(Func &&f)
+    {
+        Task task(std::forward<Func>(f));
+        push_task(task);
+    }
+
+    template <typename Func, typename Arg, typename... Args>
+    void post(Func &&f, Arg &&arg, Args &&...args)
+    {
+        post(std::bind(std::forward<Func>(f), std::forward<Arg>(arg), std::forward<Args>(args)...));
+    }
+
+    // 批量增加不需要返回值的任务，整批只同步一次，完成后tasks被清空（保留容量，可重复使用）
+    void post_batch(std::vector<Task> &tasks)
+    {
+        if (!tasks.empty())
+            push_tasks(tasks);
+    }
+
+    // 尝试增加一个任务，共享队列已满时不等待，返回false，task保持原样由调用者处理
+    bool try_post(Task &task)
+    {
+        if (mode_ == ThreadPoolMode::SharedQueue)
+        {
+            if (!task_queue_.push(std::move(task)))
+                return false;
+            pending_tasks_++;
+            wake_workers(1);
+            return true;
+        }
+
+        push_task(task);
+        return true;
+    }
+
+    // 尝试批量增加任务，按顺序送入队列放得下的部分，送入的任务从tasks中移除
+    // 返回送入的任务数，队列满时tasks中剩下没有送入的任务
+    int try_post_batch(std::vector<Task> &tasks)
+    {
+        if (tasks.empty())
+            return 0;
+        if (mode_ == ThreadPoolMode::WorkStealing)
+        {
+            int n = tasks.size();
+            push_tasks(tasks);
+            return n;
+        }
+
+        int queued = 0;
+        while (queued < tasks.size() && task_queue_.push(std::move(tasks[queued])))
+            queued++;
+        tasks.erase(tasks.begin(), tasks.begin() + queued);
+
+        pending_tasks_ += queued;
+        wake_workers(queued);
+        return queued;
+    }
+
+    // 批量增加任务，返回每个任务的future
+    template <typename Func>
+    auto submit_batch(std::vector<Func> &funcs) -> std::vector<std::future<decltype(funcs[0]())>>
+    {
+        using retType = decltype(funcs[0]());
+
+        std::vector<std::future<retType>> futures;
+        std::vector<Task> tasks;
+        futures.reserve(funcs.size());
+        tasks.reserve(funcs.size());
+
+        for (auto &f : funcs)
+        {
+            std::packaged_task<retType()> packaged(std::move(f));
+            futures.push_back(packaged.get_future());
+            tasks.emplace_back(std::move(packaged));
+        }
+
+        push_tasks(tasks);
+        return futures;
     }
 };
 
@@ -2,80 +2,41 @@
 
 using namespace std;
 
-// 注册管道用于写
-RegPipe::RegPipe() : WriteOnlyFIFO<Protocal::Reg::RegRecv>(config::get("reg_fifo_path")) {}
-
-// 登录管道用于写
-LoginPipe::LoginPipe() : WriteOnlyFIFO<Protocal::Login::LoginRecv>(config::get("login_fifo_path")) {}
-
-// 发送消息管道用于写
-MsgPipe::MsgPipe() : WriteOnlyFIFO<Protocal::Msg::MsgRecv>(config::get("msg_fifo_path")) {}
-
-// 下线管道用于写
-LogoutPipe::LogoutPipe() : WriteOnlyFIFO<Protocal::Logout::LogoutRecv>(config::get("logout_fifo_path")) {}
+// 请求管道用于写
+RequestPipe::RequestPipe() : MultiplexedPipe(config::get("request_fifo_path"), FileOpenMode::WriteOnly) {}
 
+// 用户管道用于读，根据model中的设置显示响应内容
 UserRecvPipe::UserRecvPipe(string username)
-    : ReadOnlyFIFO<int>(config::get("user_fifo_path") + "/" + username) {}
-
-// 重新定义回调，显示接收到的消息
-void UserRecvPipe::recv_callback()
+    : MultiplexedPipe(config::get("user_fifo_path") + "/" + username, FileOpenMode::ReadOnly)
 {
-    // 先读前面部分，得知协议类型
-    Protocal::ProtocalType type;
-    if (!readfile(&type, sizeof(Protocal::ProtocalType)))
-        return;
-
-    // 再读后面枚举值，根据model中的设置显示响应内容
-    switch (type)
-    {
-    case Protocal::ProtocalType::LoginRet:
-    {
-        Protocal::Login::LoginStatus status;
-        // 读到EOF时返回
-        if (!readfile(&status, sizeof(Protocal::Login::LoginStatus)))
-            return;
-        UserLog::log("login", Protocal::Login::get_string_by_status(status));
-        if (status == Protocal::Login::login_success)
-            global::chat_client_data().is_online_ = true;
-        break;
-    }
-    case Protocal::ProtocalType::LogoutRet:
-    {
-        Protocal::Logout::LogoutStatus status;
-        if (!readfile(&status, sizeof(Protocal::Logout::LogoutStatus)))
-            return;
-        UserLog::log("logout", Protocal::Logout::get_string_by_status(status));
-        break;
-    }
-    case Protocal::ProtocalType::MsgRet:
-    {
-        Protocal::Msg::MsgStatus status;
-        if (!readfile(&status, sizeof(Protocal::Msg::MsgStatus)))
-            return;
-        UserLog::log("message", Protocal::Msg::get_string_by_status(status));
-        break;
-    }
-    case Protocal::ProtocalType::RegRet:
-    {
-        Protocal::Reg::RegStatus status;
-        if (!readfile(&status, sizeof(Protocal::Reg::RegStatus)))
-            return;
-        UserLog::log("register", Protocal::Reg::get_string_by_status(status));
-        break;
-    }
+    set_process_func<Protocal::Login::LoginRet>([](Protocal::Login::LoginRet ret) -> bool
+                                                {
+                                                    UserLog::log("login", Protocal::Login::get_string_by_status(ret.status));
+                                                    if (ret.status == Protocal::Login::login_success)
+                                                        global::chat_client_data().is_online_ = true;
+                                                    return true;
+                                                });
+    set_process_func<Protocal::Logout::LogoutRet>([](Protocal::Logout::LogoutRet ret) -> bool
+                                                  {
+                                                      UserLog::log("logout", Protocal::Logout::get_string_by_status(ret.status));
+                                                      return true;
+                                                  });
+    set_process_func<Protocal::Msg::MsgRet>([](Protocal::Msg::MsgRet ret) -> bool
+                                            {
+                                                UserLog::log("message", Protocal::Msg::get_string_by_status(ret.status));
+                                                return true;
+                                            });
+    set_process_func<Protocal::Reg::RegRet>([](Protocal::Reg::RegRet ret) -> bool
+                                            {
+                                                UserLog::log("register", Protocal::Reg::get_string_by_status(ret.status));
+                                                return true;
+                                            });
     // 其他用户发消息来
-    case Protocal::ProtocalType::MsgRecv:
-    {
-        char from[64], to[64], msg[64];
-        if (!readfile(from, 64) || !readfile(to, 64) || !readfile(msg, 64))
-            return;
-        UserLog::log("message", "a message from " + string(from) + " to " + string(to) + " :" + string(msg));
-        break;
-    }
-    default:
-        UtilError::error_exit("invalid protocal type " + to_string(type), false);
-        break;
-    }
+    set_process_func<Protocal::Msg::MsgRecv>([](Protocal::Msg::MsgRecv msg) -> bool
+                                             {
+                                                 UserLog::log("message", "a message from " + string(msg.from) + " to " + string(msg.to) + " :" + string(msg.msg));
+                                                 return true;
+                                             });
 }
 
 // 帮助信息
@@ -92,8 +53,14 @@ void UserInput::print_help()
 // 重新定义回调，用于处理用户输入
 void UserInput::recv_callback()
 {
-    // 读一行
-    string line = readline();
+    // 一次读取所有已输入的行，逐行处理
+    readlines([this](const char *line, size_t n)
+              { process_line(string(line, n)); });
+}
+
+// 处理一行用户输入
+void UserInput::process_line(const string &line)
+{
     stringstream ss(line);
 
     // 读取参数
@@ -124,7 +91,7 @@ void UserInput::recv_callback()
         strcpy(msg.password, password.c_str());
 
         // 发送
-        LoginPipe pipe;
+        RequestPipe pipe;
         pipe.openfile();
         pipe.send_msg(msg);
         pipe.closefile();
@@ -153,7 +120,7 @@ void UserInput::recv_callback()
         strcpy(msg.password, password.c_str());
 
         // 发送
-        RegPipe pipe;
+        RequestPipe pipe;
         pipe.openfile();
         pipe.send_msg(msg);
         pipe.closefile();
@@ -165,7 +132,7 @@ void UserInput::recv_callback()
         strcpy(msg.username, global::chat_client_data().get_username().c_str());
 
         // 发送
-        LogoutPipe pipe;
+        RequestPipe pipe;
         pipe.openfile();
         pipe.send_msg(msg);
         pipe.closefile();
@@ -195,7 +162,7 @@ void UserInput::recv_callback()
         strcpy(msg.msg, chat_message.c_str());
 
         // 发送
-        MsgPipe pipe;
+        RequestPipe pipe;
         pipe.openfile();
         pipe.send_msg(msg);
         pipe.closefile();
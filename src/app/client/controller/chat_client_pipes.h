@@ -4,7 +4,7 @@
 #include <string.h>
 
 #include "src/fd/Stdio.hpp"
-#include "src/fd/NamedPipe.h"
+#include "src/fd/MultiplexedPipe.h"
 #include "src/config/ConfigReader.h"
 
 // 协议
@@ -13,42 +13,25 @@
 // 数据
 #include "src/app/client/controller/global.h"
 
-// 注册管道用于写
-class RegPipe : public WriteOnlyFIFO<Protocal::Reg::RegRecv>
+// 请求管道用于写，注册、登录、发送消息、注销请求共用服务端的一个管道
+class RequestPipe : public MultiplexedPipe<Protocal::Reg::RegRecv,
+                                           Protocal::Login::LoginRecv,
+                                           Protocal::Msg::MsgRecv,
+                                           Protocal::Logout::LogoutRecv>
 {
 public:
-    RegPipe();
+    RequestPipe();
 };
 
-// 登录管道用于写
-class LoginPipe : public WriteOnlyFIFO<Protocal::Login::LoginRecv>
-{
-public:
-    LoginPipe();
-};
-
-// 发送消息管道用于写
-class MsgPipe : public WriteOnlyFIFO<Protocal::Msg::MsgRecv>
-{
-public:
-    MsgPipe();
-};
-
-// 下线管道用于写
-class LogoutPipe : public WriteOnlyFIFO<Protocal::Logout::LogoutRecv>
-{
-public:
-    LogoutPipe();
-};
-
-// 用户管道用于读，这个没办法指定协议了
-class UserRecvPipe : public ReadOnlyFIFO<int>
+// 用户管道用于读，服务端的各种回复与其他用户发来的消息按协议类型分发
+class UserRecvPipe : public MultiplexedPipe<Protocal::Reg::RegRet,
+                                            Protocal::Login::LoginRet,
+                                            Protocal::Msg::MsgRet,
+                                            Protocal::Logout::LogoutRet,
+                                            Protocal::Msg::MsgRecv>
 {
 public:
     UserRecvPipe(std::string username);
-
-    // 重新定义回调
-    void recv_callback();
 };
 
 // 标准输入用于读
@@ -56,6 +39,8 @@ class UserInput : public Stdin
 {
 private:
     void print_help();
+    // 处理一行用户输入
+    void process_line(const std::string &line);
 
 public:
     // 重新定义回调，用于处理用户输入
@@ -1,7 +1,6 @@
 #include <iostream>
 
-#include "src/mux/FilesListenerSelect.h"
-#include "src/mux/FilesListenerEpoll.h"
+#include "src/mux/FilesListenerFactory.h"
 #include "src/app/client/controller/chat_client_pipes.h"
 
 using namespace std;
@@ -29,9 +28,9 @@ int main()
     shared_ptr<FileDescriptor> user_input_stdin((FileDescriptor *)new UserInput());
 
     bool use_thread_pool = false;
-    // FilesListenerSelect listener(use_thread_pool);
-    FilesListenerEpoll listener(use_thread_pool);
-    listener.add_fd(user_recv_pipe);
-    listener.add_fd(user_input_stdin);
-    listener.listen();
+    // 监听方式由配置项listener_backend决定
+    std::unique_ptr<FilesListener> listener = make_files_listener(use_thread_pool);
+    listener->add_fd(user_recv_pipe);
+    listener->add_fd(user_input_stdin);
+    listener->listen();
 }
\ No newline at end of file
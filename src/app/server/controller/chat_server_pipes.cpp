@@ -2,10 +2,10 @@
 
 using namespace std;
 
-RegPipe::RegPipe() : ReadOnlyFIFO(config::get("reg_fifo_path"))
+RequestPipe::RequestPipe() : MultiplexedPipe(config::get("request_fifo_path"), FileOpenMode::ReadOnly)
 {
-    // 回调函数
-    auto handler = [](Protocal::Reg::RegRecv reg_recv) -> bool
+    // 注册
+    auto reg_handler = [](Protocal::Reg::RegRecv reg_recv) -> bool
     {
         Protocal::Reg::RegRet reg_ret;
         string username(reg_recv.username);
@@ -24,23 +24,14 @@ RegPipe::RegPipe() : ReadOnlyFIFO(config::get("reg_fifo_path"))
         else
             reg_ret.status = Protocal::Reg::username_has_been_registered;
 
-        // 返回内容给用户
-        WriteOnlyFIFO<Protocal::Reg::RegRet> user_fifo(config::get("user_fifo_path") + username);
-        user_fifo.openfile();
-        user_fifo.send_msg(reg_ret);
-        user_fifo.closefile();
+        // 返回内容给用户，注册不是会话的一部分，不放入缓存
+        global::user_fifos().send_once(username, reg_ret);
 
         return true;
     };
 
-    // 设置回调函数为上述函数
-    this->set_process_func(handler);
-}
-
-LoginPipe::LoginPipe() : ReadOnlyFIFO(config::get("login_fifo_path"))
-{
-    // 回调函数
-    auto handler = [](Protocal::Login::LoginRecv login_recv) -> bool
+    // 登录
+    auto login_handler = [](Protocal::Login::LoginRecv login_recv) -> bool
     {
         Protocal::Login::LoginRet login_ret;
         string username(login_recv.username);
@@ -59,23 +50,17 @@ LoginPipe::LoginPipe() : ReadOnlyFIFO(config::get("login_fifo_path"))
         else
             login_ret.status = Protocal::Login::login_success;
 
-        // 返回内容给用户
-        WriteOnlyFIFO<Protocal::Login::LoginRet> user_fifo(config::get("user_fifo_path") + username);
-        user_fifo.openfile();
-        user_fifo.send_msg(login_ret);
-        user_fifo.closefile();
+        // 返回内容给用户，登录成功时打开并放入缓存（用户可能重新创建了管道），失败时只回复一次
+        if (login_ret.status == Protocal::Login::login_success)
+            global::user_fifos().reopen(username)->send(login_ret);
+        else
+            global::user_fifos().send_once(username, login_ret);
 
         return true;
     };
 
-    // 设置回调函数为上述函数
-    this->set_process_func(handler);
-}
-
-MsgPipe::MsgPipe() : ReadOnlyFIFO(config::get("msg_fifo_path"))
-{
-    // 回调函数
-    auto handler = [](Protocal::Msg::MsgRecv msg_recv) -> bool
+    // 发送消息
+    auto msg_handler = [](Protocal::Msg::MsgRecv msg_recv) -> bool
     {
         Protocal::Msg::MsgRet msg_ret;
 
@@ -105,29 +90,20 @@ MsgPipe::MsgPipe() : ReadOnlyFIFO(config::get("msg_fifo_path"))
             msg_ret.status = Protocal::Msg::forward_success;
 
             // 转发消息给to
-            WriteOnlyFIFO<Protocal::Msg::MsgRecv> to_fifo(config::get("user_fifo_path") + to);
-            to_fifo.openfile();
-            to_fifo.send_msg(msg_recv);
-            to_fifo.closefile();
+            global::user_fifos().get(to)->send(msg_recv);
         }
 
-        // 返回内容给from
-        WriteOnlyFIFO<Protocal::Msg::MsgRet> from_fifo(config::get("user_fifo_path") + from);
-        from_fifo.openfile();
-        from_fifo.send_msg(msg_ret);
-        from_fifo.closefile();
+        // 返回内容给from，from不在线时只回复一次，不放入缓存
+        if (global::chat_server_data().user_is_online(from))
+            global::user_fifos().get(from)->send(msg_ret);
+        else
+            global::user_fifos().send_once(from, msg_ret);
 
         return true;
     };
 
-    // 设置回调函数为上述函数
-    this->set_process_func(handler);
-}
-
-LogoutPipe::LogoutPipe() : ReadOnlyFIFO(config::get("logout_fifo_path"))
-{
-    // 回调函数
-    auto handler = [](Protocal::Logout::LogoutRecv logout_recv) -> bool
+    // 注销
+    auto logout_handler = [](Protocal::Logout::LogoutRecv logout_recv) -> bool
     {
         Protocal::Logout::LogoutRet logout_ret;
         string username(logout_recv.username);
@@ -142,15 +118,22 @@ LogoutPipe::LogoutPipe() : ReadOnlyFIFO(config::get("logout_fifo_path"))
         else
             logout_ret.status = Protocal::Logout::logout_success;
 
-        // 返回内容给from
-        WriteOnlyFIFO<Protocal::Logout::LogoutRet> user_fifo(config::get("user_fifo_path") + username);
-        user_fifo.openfile();
-        user_fifo.send_msg(logout_ret);
-        user_fifo.closefile();
+        // 返回内容给from，登出后关闭管道，管道已满时回复在队列中写完后才关闭
+        // 用户本来不在线时只回复一次，不放入缓存
+        if (logout_ret.status == Protocal::Logout::logout_success)
+        {
+            global::user_fifos().get(username)->send(logout_ret);
+            global::user_fifos().evict(username);
+        }
+        else
+            global::user_fifos().send_once(username, logout_ret);
 
         return true;
     };
 
-    // 设置回调函数为上述函数
-    this->set_process_func(handler);
+    // 按协议类型设置回调函数为上述函数
+    this->set_process_func<Protocal::Reg::RegRecv>(reg_handler);
+    this->set_process_func<Protocal::Login::LoginRecv>(login_handler);
+    this->set_process_func<Protocal::Msg::MsgRecv>(msg_handler);
+    this->set_process_func<Protocal::Logout::LogoutRecv>(logout_handler);
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #include <functional>
 
-#include "src/fd/NamedPipe.h"
+#include "src/fd/MultiplexedPipe.h"
 #include "src/mux/FilesListener.h"
 #include "src/config/ConfigReader.h"
 
@@ -10,30 +10,12 @@
 // 数据
 #include "src/app/server/controller/global.h"
 
-// 注册管道
-class RegPipe : public ReadOnlyFIFO<Protocal::Reg::RegRecv>
+// 请求管道，所有客户端的注册、登录、发送消息、注销请求共用一个管道，按协议类型分发
+class RequestPipe : public MultiplexedPipe<Protocal::Reg::RegRecv,
+                                           Protocal::Login::LoginRecv,
+                                           Protocal::Msg::MsgRecv,
+                                           Protocal::Logout::LogoutRecv>
 {
 public:
-    RegPipe();
-};
-
-// 登录管道
-class LoginPipe : public ReadOnlyFIFO<Protocal::Login::LoginRecv>
-{
-public:
-    LoginPipe();
-};
-
-// 发送消息管道
-class MsgPipe : public ReadOnlyFIFO<Protocal::Msg::MsgRecv>
-{
-public:
-    MsgPipe();
-};
-
-// 注销管道
-class LogoutPipe : public ReadOnlyFIFO<Protocal::Logout::LogoutRecv>
-{
-public:
-    LogoutPipe();
+    RequestPipe();
 };
\ No newline at end of file
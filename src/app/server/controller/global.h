@@ -7,6 +7,8 @@
 #include <queue>
 #include <unordered_set>
 
+#include "src/fd/FIFOCache.h"
+#include "src/config/ConfigReader.h"
 #include "src/app/server/model/chat_models.h"
 
 // 全局变量文件，用户自己编写
@@ -134,6 +136,21 @@ public:
         static ChatServerData dao;
         return dao;
     }
+
+    // 回复用户的命名管道，按用户名缓存已打开的管道，登录时重新打开，登出时关闭
+    // 最多缓存reply_fifo_cache_size个（默认1024），超过时关闭最久未使用的
+    // 用户管道已满时回复放入发送队列，超过reply_fifo_high_water字节（默认262144）时丢弃并重新打开
+    // reply_fifo_pipe_size大于0时打开后把管道容量设置为该值（字节）
+    // 登出、淘汰的管道在发送队列写完后关闭，最多等待reply_fifo_close_timeout毫秒（默认10000）
+    static FIFOCache &user_fifos()
+    {
+        static FIFOCache cache(config::get("user_fifo_path"),
+                               atoi(config::get("reply_fifo_cache_size", "1024").c_str()),
+                               atoll(config::get("reply_fifo_high_water", "262144").c_str()),
+                               atoi(config::get("reply_fifo_pipe_size", "0").c_str()),
+                               atoi(config::get("reply_fifo_close_timeout", "10000").c_str()));
+        return cache;
+    }
 };
 
 #endif // __SERVER_GLOBAL_H__
\ No newline at end of file
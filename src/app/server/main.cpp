@@ -1,36 +1,23 @@
-#include "src/mux/FilesListenerEpoll.h"
-#include "src/mux/FilesListenerSelect.h"
+#include "src/mux/FilesListenerFactory.h"
 #include "src/app/server/controller/chat_server_pipes.h"
 
 int main()
 {
     // UtilSystem::init_daemon();
 
-    // 注册管道
-    shared_ptr<FileDescriptor> reg_pipe = make_shared<RegPipe>();
-    reg_pipe->createfile();
-
-    // 登录管道
-    shared_ptr<FileDescriptor> login_pipe = make_shared<LoginPipe>();
-    login_pipe->createfile();
-
-    // 发消息管道
-    shared_ptr<FileDescriptor> msg_pipe = make_shared<MsgPipe>();
-    msg_pipe->createfile();
-
-    // 注销管道
-    shared_ptr<FileDescriptor> logout_pipe = make_shared<LogoutPipe>();
-    logout_pipe->createfile();
+    // 请求管道，注册、登录、发消息、注销共用
+    shared_ptr<FileDescriptor> request_pipe = make_shared<RequestPipe>();
+    request_pipe->createfile();
 
     // 添加到多路复用的监听集合中
     bool use_thread_pool = false;
-    // FilesListenerSelect listener(use_thread_pool);
-    FilesListenerEpoll listener(use_thread_pool);
-    listener.add_fd(reg_pipe);
-    listener.add_fd(login_pipe);
-    listener.add_fd(msg_pipe);
-    listener.add_fd(logout_pipe);
+    // 监听方式由配置项listener_backend决定
+    std::unique_ptr<FilesListener> listener = make_files_listener(use_thread_pool);
+    listener->add_fd(request_pipe);
+
+    // 用户管道已满时，由监听器等待可写后继续回复
+    global::user_fifos().set_listener(listener.get());
 
     // 开始服务器
-    listener.listen();
+    listener->listen();
 }
\ No newline at end of file
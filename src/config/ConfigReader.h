@@ -53,6 +53,7 @@ private:
 
 public:
     ConfigReader(std::string path) { read_kv_config(path); }
+    bool has(std::string key) { return config_.find(key) != config_.end(); }
     std::string get(std::string key)
     {
         auto it = config_.find(key);
@@ -81,6 +82,14 @@ public:
     {
         return get_config().get(key);
     }
+
+    // 可选配置项，不存在时返回默认值
+    static std::string get(std::string key, std::string default_value)
+    {
+        if (!get_config().has(key))
+            return default_value;
+        return get_config().get(key);
+    }
 };
 
 #endif // __CONFIG_READER_H__
\ No newline at end of file
@@ -0,0 +1,525 @@
+#ifndef __FIFO_CACHE_H__
+#define __FIFO_CACHE_H__
+
+#include <list>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "src/fd/NamedPipe.h"
+#include "src/mux/FilesListener.h"
+
+// 回复用的只写命名管道，消息类型在发送时决定，同一个管道可以发送不同协议的消息
+// 写不进去（读端太慢、管道已满）时不阻塞也不退出，剩下的数据放入发送队列，
+// 通过监听器等待可写后按顺序写出；队列中已有数据时新消息直接排在后面，保证顺序
+// 队列超过high_water字节时认为读端太慢：丢弃还没开始写出的消息、不再发送，已写出一部分的消息仍会写完，
+// 读端不会收到不完整的消息；写完后由FIFOCache关闭并重新打开
+// 没有设置监听器时只在下次发送时尝试写出队列。析构时关闭文件，队列中没写出的数据丢弃，
+// 需要写完再关闭时（比如用户登出的回复）使用close_after_flush()
+class ReplyFIFO : public NamedPipe<int, int>, public std::enable_shared_from_this<ReplyFIFO>
+{
+private:
+    FilesListener *listener_ = NULL;
+    size_t high_water_;
+    // 发送队列，每项是一次发送的完整数据（一条消息或send_many()合并的一组），保留消息的边界
+    // 队首的前front_written_字节已经写出
+    std::deque<std::string> queue_;
+    size_t front_written_ = 0;
+    // 还没写出的字节数
+    std::atomic<size_t> queued_{0};
+    // 正在等待可写
+    bool waiting_ = false;
+    // 读端太慢，已丢弃队列
+    std::atomic<bool> slow_{false};
+    // close_after_flush()后队列还没写完时持有自己，写完、出错或超时后释放
+    std::shared_ptr<ReplyFIFO> closing_self_;
+    // 每次close_after_flush()加一，忽略上一次的超时
+    unsigned close_gen_ = 0;
+    // 写出队列时一次writev的最多项数
+    static const int FLUSH_IOV = 64;
+
+    size_t queued() { return queued_; }
+
+    // 非阻塞地写出尽量多的数据，返回写出的字节数，出错返回-1
+    int write_some(const struct iovec *iov, int iovcnt)
+    {
+        while (true)
+        {
+            int res = writev(fd_, iov, iovcnt);
+            if (res >= 0)
+                return res;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno != EINTR)
+            {
+                Log::warn("write to " + path_ + " failed: " + std::string(strerror(errno)));
+                return -1;
+            }
+        }
+    }
+
+    // 写出队列中的数据，写不完时等待可写
+    bool flush()
+    {
+        while (!queue_.empty())
+        {
+            struct iovec iov[FLUSH_IOV];
+            int cnt = 0;
+            for (auto it = queue_.begin(); it != queue_.end() && cnt < FLUSH_IOV; ++it, ++cnt)
+            {
+                size_t skip = cnt == 0 ? front_written_ : 0;
+                iov[cnt].iov_base = (void *)(it->data() + skip);
+                iov[cnt].iov_len = it->size() - skip;
+            }
+            int res = write_some(iov, cnt);
+            if (res < 0)
+                return false;
+            if (res == 0)
+            {
+                wait_writable();
+                return true;
+            }
+
+            // 弹出已经写完的项，最后一项可能只写出一部分
+            queued_ -= res;
+            size_t left = res;
+            while (left > 0)
+            {
+                size_t rest = queue_.front().size() - front_written_;
+                if (left < rest)
+                {
+                    front_written_ += left;
+                    break;
+                }
+                left -= rest;
+                queue_.pop_front();
+                front_written_ = 0;
+            }
+        }
+        return true;
+    }
+
+    // 读端太慢：丢弃还没开始写出的消息，已写出一部分的队首留在队列中继续写完
+    void drop_queue()
+    {
+        size_t keep = front_written_ > 0 ? 1 : 0;
+        size_t dropped = 0;
+        while (queue_.size() > keep)
+        {
+            dropped += queue_.back().size();
+            queue_.pop_back();
+        }
+        queued_ -= dropped;
+        slow_ = true;
+        Log::warn("reader of " + path_ + " is too slow, drop " + std::to_string(dropped) + " queued bytes");
+    }
+
+    // 通过监听器等待可写，就绪时继续写出队列；文件已被释放时不操作
+    void wait_writable()
+    {
+        if (waiting_ || listener_ == NULL)
+            return;
+        std::weak_ptr<ReplyFIFO> self = shared_from_this();
+        waiting_ = listener_->wait_writable(fd_, Task([self]()
+                                                      {
+                                                          std::shared_ptr<ReplyFIFO> fifo = self.lock();
+                                                          if (fifo)
+                                                              fifo->on_writable();
+                                                      }));
+        if (!waiting_)
+            Log::warn("wait " + path_ + " writable failed, " + std::to_string(queued()) + " bytes stay in queue");
+    }
+
+    // 读端太慢时队列中只剩写了一部分的消息，仍然写完；close_after_flush()后写完或出错时释放自己
+    void on_writable()
+    {
+        // 最后一个引用可能是closing_self_，在解锁之后释放
+        std::shared_ptr<ReplyFIFO> self;
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        waiting_ = false;
+        bool ok = is_open_ && flush();
+        if (!ok || queue_.empty())
+            self.swap(closing_self_);
+    }
+
+    // close_after_flush()等待超时，读端一直不读：丢弃队列，之后发送失败（与读端太慢相同）
+    void close_timeout(unsigned close_gen)
+    {
+        std::shared_ptr<ReplyFIFO> self;
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (!closing_self_ || close_gen != close_gen_)
+            return;
+        Log::warn("reader of " + path_ + " does not read before close, drop " + std::to_string(queued()) + " queued bytes");
+        queue_.clear();
+        front_written_ = 0;
+        queued_ = 0;
+        slow_ = true;
+        self.swap(closing_self_);
+    }
+
+    // 写出n字节，写不完的部分放入队列
+    bool enqueue(const void *buf, size_t n)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        // 读端太慢时不再发送，没有监听器时在这里继续写完剩下的一条消息
+        if (slow_)
+        {
+            if (is_open_)
+                flush();
+            return false;
+        }
+        check_file_open();
+
+        // 先尝试写出以前排队的数据
+        if (!flush())
+            return false;
+
+        size_t done = 0;
+        if (queue_.empty())
+        {
+            struct iovec iov;
+            iov.iov_base = (void *)buf;
+            iov.iov_len = n;
+            int res = write_some(&iov, 1);
+            if (res < 0)
+                return false;
+            done = res;
+            if (done == n)
+                return true;
+        }
+        // 队列为空时总是接收，消息不会只写出一半
+        else if (queued() + n > high_water_)
+        {
+            drop_queue();
+            return false;
+        }
+
+        queue_.emplace_back((const char *)buf, n);
+        if (queue_.size() == 1)
+            front_written_ = done;
+        queued_ += n - done;
+        wait_writable();
+        return true;
+    }
+
+public:
+    // high_water为发送队列的最大字节数，listener用于等待可写，可以为NULL
+    ReplyFIFO(const std::string &path, size_t high_water = 262144, FilesListener *listener = NULL)
+        : NamedPipe<int, int>(path, FileOpenMode::WriteOnly), listener_(listener), high_water_(high_water) {}
+
+    ~ReplyFIFO()
+    {
+        if (waiting_)
+            listener_->cancel_wait(fd_);
+        if (queued() > 0)
+            Log::debug("drop " + std::to_string(queued()) + " queued bytes to " + path_);
+        if (is_open_)
+            closefile();
+    }
+
+    // 设置管道容量（F_SETPIPE_SZ），需要在打开之后调用，返回实际的容量，失败返回-1
+    int set_pipe_size(int size)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        check_file_open();
+        int res = fcntl(fd_, F_SETPIPE_SZ, size);
+        if (res == -1)
+            Log::warn("set pipe size of " + path_ + " to " + std::to_string(size) + " failed: " + std::string(strerror(errno)));
+        return res;
+    }
+
+    // 发送队列写完之前持有自己，调用者（比如从缓存中删除时）释放后已发送的数据仍会写完，最后一个持有者释放时关闭
+    // 队列为空或没有监听器时不操作。超过timeout_ms毫秒（大于0时）还没写完则丢弃队列，之后发送失败
+    void close_after_flush(int timeout_ms)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (!is_open_ || queue_.empty() || listener_ == NULL || closing_self_)
+            return;
+        closing_self_ = shared_from_this();
+        if (timeout_ms <= 0)
+            return;
+
+        std::weak_ptr<ReplyFIFO> weak = closing_self_;
+        unsigned close_gen = ++close_gen_;
+        FilesListener *listener = listener_;
+        listener_->post(Task([listener, weak, timeout_ms, close_gen]()
+                             { listener->timers().schedule(timeout_ms, [weak, close_gen]()
+                                                           {
+                                                               std::shared_ptr<ReplyFIFO> fifo = weak.lock();
+                                                               if (fifo)
+                                                                   fifo->close_timeout(close_gen);
+                                                           }); }));
+    }
+
+    // 取消close_after_flush()，继续使用（比如用户在队列写完之前重新登录）
+    // 队列已经写完、已经关闭或不能再发送时返回false，这时重新打开不会与它交错写入
+    bool reclaim()
+    {
+        std::shared_ptr<ReplyFIFO> self;
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (!closing_self_)
+            return false;
+        self.swap(closing_self_);
+        return is_open_ && !slow_;
+    }
+
+    // 打开的管道与路径上的文件是同一个（读端没有重新创建管道）
+    bool same_file()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        struct stat opened, current;
+        return is_open_ && fstat(fd_, &opened) == 0 && stat(path_.c_str(), &current) == 0 &&
+               opened.st_dev == current.st_dev && opened.st_ino == current.st_ino;
+    }
+
+    // 读端太慢，队列已被丢弃、写了一部分的消息也已写完，需要重新打开
+    // 还在写完最后一条消息时返回false，这期间发送失败
+    bool is_slow() { return slow_ && queued_ == 0; }
+
+    // 还没写出的字节数
+    size_t queued_bytes()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        return queued();
+    }
+
+    // 发送一条消息，写不进去时放入队列，读端太慢或出错时返回false
+    template <typename RetMsgStruct>
+    bool send(const RetMsgStruct &msg) { return enqueue(&msg, sizeof(RetMsgStruct)); }
+
+    // 一次发送多条消息，每次写入整数条，合计不超过PIPE_BUF，写不进去的部分放入队列
+    template <typename RetMsgStruct>
+    bool send_many(const std::vector<RetMsgStruct> &msgs)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        size_t per_write = std::max<size_t>(1, PIPE_BUF / sizeof(RetMsgStruct));
+        for (size_t i = 0; i < msgs.size(); i += per_write)
+            if (!enqueue(msgs.data() + i, std::min(per_write, msgs.size() - i) * sizeof(RetMsgStruct)))
+                return false;
+        return true;
+    }
+};
+
+// 已打开的回复管道缓存，按名字（比如用户名）查找，路径为dir + 名字
+// 回复时不需要每次检查文件、打开、关闭，数量超过capacity时关闭最久未使用的管道
+// 线程安全，取出的管道由共享指针持有，被淘汰时正在使用的线程仍可以写完，最后一个持有者释放时关闭
+// 读端太慢的管道（见ReplyFIFO）在下次取出时关闭并重新打开，丢弃的数据不会再发送
+// 删除或淘汰的管道在发送队列写完后才关闭，最多等待close_timeout毫秒；这期间再次取出时继续使用同一个管道，
+// 不会与新打开的管道交错写入
+class FIFOCache
+{
+private:
+    struct Entry
+    {
+        std::shared_ptr<ReplyFIFO> fifo;
+        std::list<std::string>::iterator lru_pos;
+    };
+
+    std::string dir_;
+    size_t capacity_;
+    // 每个管道发送队列的最大字节数
+    size_t high_water_;
+    // 打开后设置的管道容量，0表示不设置
+    int pipe_size_;
+    // 删除后等待写完再关闭的最长时间（毫秒）
+    int close_timeout_;
+    FilesListener *listener_ = NULL;
+    std::mutex mutex_;
+    // 最近使用的在前
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    // 已删除、可能还在写完发送队列的管道
+    std::unordered_map<std::string, std::weak_ptr<ReplyFIFO>> closing_;
+
+    // 不在缓存中的管道在发送队列写完、最后一个持有者释放后关闭，这期间可以被取回，需要持有锁
+    void close_later(const std::string &name, std::shared_ptr<ReplyFIFO> fifo)
+    {
+        // 清理已经关闭的
+        if (closing_.size() >= capacity_)
+            for (auto c = closing_.begin(); c != closing_.end();)
+                c = c->second.expired() ? closing_.erase(c) : std::next(c);
+        closing_[name] = fifo;
+        fifo->close_after_flush(close_timeout_);
+    }
+
+    // 从缓存中删除，发送队列写完、最后一个持有者释放后关闭，需要持有锁
+    void remove(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        std::shared_ptr<ReplyFIFO> fifo = it->second.fifo;
+        std::string name = it->first;
+        lru_.erase(it->second.lru_pos);
+        entries_.erase(it);
+        close_later(name, fifo);
+    }
+
+    // 取回还在写完发送队列的管道，reopen为true时只取回读端没有重新创建的，没有可以取回的返回NULL，需要持有锁
+    std::shared_ptr<ReplyFIFO> take_closing(const std::string &name, bool reopen)
+    {
+        auto it = closing_.find(name);
+        if (it == closing_.end())
+            return NULL;
+        std::shared_ptr<ReplyFIFO> fifo = it->second.lock();
+        closing_.erase(it);
+        if (fifo && (!reopen || fifo->same_file()) && fifo->reclaim())
+            return fifo;
+        return NULL;
+    }
+
+    // 打开管道，不持有锁，打开文件较慢时不影响其他线程使用缓存
+    std::shared_ptr<ReplyFIFO> open(const std::string &name)
+    {
+        auto fifo = std::make_shared<ReplyFIFO>(dir_ + name, high_water_, listener_);
+        fifo->openfile();
+        if (pipe_size_ > 0)
+            fifo->set_pipe_size(pipe_size_);
+        return fifo;
+    }
+
+    // 放入缓存，超过容量时淘汰最久未使用的
+    // 已存在的管道不直接覆盖，和删除时一样在发送队列写完后关闭，已经发送的回复不会丢失
+    void insert(const std::string &name, std::shared_ptr<ReplyFIFO> fifo)
+    {
+        auto it = entries_.find(name);
+        if (it != entries_.end())
+            remove(it);
+
+        lru_.push_front(name);
+        Entry entry;
+        entry.fifo = fifo;
+        entry.lru_pos = lru_.begin();
+        entries_[name] = entry;
+
+        if (entries_.size() > capacity_)
+            remove(entries_.find(lru_.back()));
+    }
+
+public:
+    FIFOCache(const std::string &dir, size_t capacity, size_t high_water = 262144, int pipe_size = 0, int close_timeout = 10000)
+        : dir_(dir), capacity_(capacity), high_water_(high_water), pipe_size_(pipe_size), close_timeout_(close_timeout)
+    {
+        if (capacity_ == 0)
+            UtilError::error_exit("FIFO cache capacity can not be 0", false);
+        if (high_water_ == 0)
+            UtilError::error_exit("FIFO cache high water can not be 0", false);
+    }
+
+    // 设置等待管道可写的监听器，之后打开的管道写不进去时由监听器在可写时继续写出，需要在使用缓存之前设置
+    void set_listener(FilesListener *listener) { listener_ = listener; }
+
+    // 取出名字对应的管道，不在缓存中则打开并放入缓存
+    // 读端太慢的管道先从缓存中删除（队列已经写完），再重新打开
+    std::shared_ptr<ReplyFIFO> get(const std::string &name)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(name);
+            if (it != entries_.end() && !it->second.fifo->is_slow())
+            {
+                lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+                return it->second.fifo;
+            }
+            if (it != entries_.end())
+                remove(it);
+            else
+            {
+                auto fifo = take_closing(name, false);
+                if (fifo)
+                {
+                    insert(name, fifo);
+                    return fifo;
+                }
+            }
+        }
+
+        auto fifo = open(name);
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 打开期间其他线程已经放入缓存，使用已有的，新打开的在返回后关闭
+        auto it = entries_.find(name);
+        if (it != entries_.end() && !it->second.fifo->is_slow())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+            return it->second.fifo;
+        }
+        insert(name, fifo);
+        return fifo;
+    }
+
+    // 重新打开并放入缓存（比如用户登录时，对方可能重新创建了管道）
+    // 缓存中或者还在写完发送队列的管道，读端没有重新创建时继续使用，保证顺序
+    std::shared_ptr<ReplyFIFO> reopen(const std::string &name)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(name);
+            if (it != entries_.end() && !it->second.fifo->is_slow() && it->second.fifo->same_file())
+            {
+                lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+                return it->second.fifo;
+            }
+            auto fifo = take_closing(name, true);
+            if (fifo)
+            {
+                insert(name, fifo);
+                return fifo;
+            }
+        }
+
+        auto fifo = open(name);
+        std::lock_guard<std::mutex> lock(mutex_);
+        insert(name, fifo);
+        return fifo;
+    }
+
+    // 发送一次性的回复（比如注册、登录失败时），不放入缓存，写完后关闭
+    // 名字在缓存中，或者管道还在写完发送队列时使用同一个管道，不会与它交错写入
+    template <typename RetMsgStruct>
+    bool send_once(const std::string &name, const RetMsgStruct &msg)
+    {
+        std::shared_ptr<ReplyFIFO> fifo;
+        bool cached;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cached = entries_.find(name) != entries_.end();
+            auto it = closing_.find(name);
+            if (!cached && it != closing_.end())
+                fifo = it->second.lock();
+        }
+        if (cached)
+            return get(name)->send(msg);
+
+        if (!fifo || fifo->is_slow() || !fifo->same_file())
+            fifo = open(name);
+        bool res = fifo->send(msg);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        close_later(name, fifo);
+        return res;
+    }
+
+    // 从缓存中删除（比如用户登出时），已发送的回复写完后关闭，不在缓存中返回false
+    bool evict(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(name);
+        if (it == entries_.end())
+            return false;
+        remove(it);
+        return true;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+};
+
+#endif // __FIFO_CACHE_H__
@@ -1,4 +1,121 @@
 #include "src/fd/FileDescriptor.h"
+#include "src/config/ConfigReader.h"
+
+#include <chrono>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+// 等待fd可读或可写
+static void wait_fd(int fd, short events)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = events;
+    poll(&p, 1, -1);
+}
+
+// 非阻塞文件写完n字节，满时等待可写
+static void write_all(int fd, const char *buf, size_t n)
+{
+    while (n > 0)
+    {
+        int res = write(fd, buf, n);
+        if (res == -1 && (errno == EAGAIN || errno == EINTR))
+        {
+            wait_fd(fd, POLLOUT);
+            continue;
+        }
+        if (res == -1)
+            UtilError::error_exit("fd " + std::to_string(fd) + ": forward write failed", true);
+        buf += res;
+        n -= res;
+    }
+}
+
+// 非阻塞文件读满n字节，没有数据时等待
+static void read_all(int fd, char *buf, size_t n)
+{
+    while (n > 0)
+    {
+        int res = read(fd, buf, n);
+        if (res == -1 && (errno == EAGAIN || errno == EINTR))
+        {
+            wait_fd(fd, POLLIN);
+            continue;
+        }
+        if (res <= 0)
+            UtilError::error_exit("fd " + std::to_string(fd) + ": forward read failed", true);
+        buf += res;
+        n -= res;
+    }
+}
+
+// 管道中的字节数
+static size_t pipe_bytes(int fd)
+{
+    int n = 0;
+    ioctl(fd, FIONREAD, &n);
+    return n;
+}
+
+// 目标中放不下len字节的一个，都放得下返回-1
+// 不超过PIPE_BUF时可写（有一个空的缓冲槽）就一定放得下，所有目标一次poll；更大时比较管道容量与已有的字节数，超过容量时等到目标为空
+static int find_full_dst(const std::vector<int> &dsts, size_t len)
+{
+    if (len <= PIPE_BUF)
+    {
+        std::vector<struct pollfd> ps(dsts.size());
+        for (size_t i = 0; i < dsts.size(); i++)
+        {
+            ps[i].fd = dsts[i];
+            ps[i].events = POLLOUT;
+        }
+        if (poll(ps.data(), ps.size(), 0) == (int)ps.size())
+            return -1;
+        for (size_t i = 0; i < ps.size(); i++)
+            if (!(ps[i].revents & POLLOUT))
+                return dsts[i];
+        return -1;
+    }
+
+    for (int dst : dsts)
+    {
+        size_t capacity = fcntl(dst, F_GETPIPE_SZ);
+        if (capacity - std::min(capacity, pipe_bytes(dst)) < std::min(len, capacity))
+            return dst;
+    }
+    return -1;
+}
+
+// 转发开始之前等待来源有n字节、每个目标放得下len字节，最多等待timeout_ms毫秒
+// 可读、可写只说明有数据、有空间，还不够时每毫秒检查一次
+static bool wait_forward_ready(int src, size_t n, const std::vector<int> &dsts, size_t len, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        struct pollfd p;
+        p.fd = -1;
+        if (pipe_bytes(src) < n)
+        {
+            p.fd = src;
+            p.events = POLLIN;
+        }
+        else if ((p.fd = find_full_dst(dsts, len)) != -1)
+            p.events = POLLOUT;
+        else
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+        int left = (std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count() + 999) / 1000;
+        if (poll(&p, 1, left) > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
 
 void FileDescriptor::check_file_open()
 {
@@ -18,8 +135,13 @@ void FileDescriptor::check_file_open()
 
 void FileDescriptor::check_read_result(int res)
 {
+    // 非阻塞文件暂时没有数据（比如同一次就绪被处理了两次），不是错误，由调用者处理
+    if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        Log::debug("fd " + std::to_string(fd_) + " has no data to read");
+    }
     // 读取失败，抛出异常
-    if (res == -1)
+    else if (res == -1)
     {
         std::string err = "file read error";
         UtilError::error_exit(err, true);
@@ -93,6 +215,155 @@ int FileDescriptor::writefile(void *buf, size_t n)
     return res;
 }
 
+int FileDescriptor::writevfile(const struct iovec *iov, int iovcnt)
+{
+    // 上锁
+    std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+
+    if (open_mode_ == FileOpenMode::ReadOnly)
+    {
+        std::string err = "attempt to write in read only file.";
+        UtilError::error_exit(err, false);
+    }
+
+    check_file_open();
+    int res = writev(fd_, iov, iovcnt);
+    check_write_result(res);
+
+    // log
+    Log::debug(std::to_string(res) + " bytes in " + std::to_string(iovcnt) +
+               " buffers was sent to: " + std::to_string(fd_));
+
+    return res;
+}
+
+bool FileDescriptor::send_iov(const struct iovec *iov, int iovcnt)
+{
+    // 上锁，多次writev之间不会插入同一进程其他线程的写入
+    std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+
+    int i = 0;
+    while (i < iovcnt)
+    {
+        // 合并相邻的记录直到超过PIPE_BUF，超过PIPE_BUF的记录单独写
+        int begin = i;
+        size_t bytes = iov[i++].iov_len;
+        while (i < iovcnt && i - begin < IOV_MAX && bytes + iov[i].iov_len <= PIPE_BUF)
+            bytes += iov[i++].iov_len;
+
+        int res = writevfile(iov + begin, i - begin);
+
+        // 缺
+        if (res < (int)bytes)
+        {
+            UtilError::error_exit("fd " + std::to_string(fd_) + ": number of bytes write is not equal to number of bytes in iov", false);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FileDescriptor::splice_to(std::vector<FileDescriptor *> dsts, size_t n, const void *prefix, size_t prefix_len, int timeout_ms, bool use_splice)
+{
+    std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+    check_file_open();
+
+    // 目标按地址顺序加锁，多个线程转发到相同的目标时不会死锁
+    std::sort(dsts.begin(), dsts.end());
+    dsts.erase(std::unique(dsts.begin(), dsts.end()), dsts.end());
+    if (dsts.empty())
+        return false;
+    std::vector<std::unique_lock<std::recursive_mutex>> dst_locks;
+    std::vector<int> dst_fds;
+    for (FileDescriptor *dst : dsts)
+    {
+        dst_locks.emplace_back(dst->file_operation_mutex_);
+        dst->check_file_open();
+        dst_fds.push_back(dst->fd_);
+    }
+
+    // 等待期间持有所有的锁，只在还没有读写任何数据时等待有限的时间，超时返回false，管道中的数据不变
+    if (!wait_forward_ready(fd_, n, dst_fds, prefix_len + n, timeout_ms))
+    {
+        Log::warn("forward from fd " + std::to_string(fd_) + " timed out, source has no data or destination is full");
+        return false;
+    }
+
+    // tee/splice转过去的每一段数据都单独占用目标管道的一个缓冲槽（默认每个管道16个），
+    // 小消息这样转发会让目标管道只能容纳很少的消息，小于forward_splice_min字节时读出后与prefix一起写入
+    // 每次调用时读取配置，配置重新加载后立即生效
+    size_t splice_min = atoi(config::get("forward_splice_min", "4096").c_str());
+    if (!use_splice || n < splice_min)
+    {
+        std::vector<char> buf(prefix_len + n);
+        if (prefix_len > 0)
+            memcpy(buf.data(), prefix, prefix_len);
+        read_all(fd_, buf.data() + prefix_len, n);
+        for (FileDescriptor *dst : dsts)
+            write_all(dst->fd_, buf.data(), buf.size());
+
+        Log::debug(std::to_string(n) + " bytes was forwarded by copy from: " + std::to_string(fd_));
+        return true;
+    }
+
+    if (prefix_len > 0)
+        for (FileDescriptor *dst : dsts)
+            write_all(dst->fd_, (const char *)prefix, prefix_len);
+
+    // tee不消耗数据，每次都从头复制，记下每个目标已复制的字节数
+    std::vector<size_t> copied(dsts.size(), 0);
+    bool complete = true;
+    for (size_t i = 0; i + 1 < dsts.size(); i++)
+    {
+        ssize_t res = tee(fd_, dsts[i]->fd_, n, SPLICE_F_NONBLOCK);
+        if (res == -1 && errno != EAGAIN)
+            UtilError::error_exit("fd " + std::to_string(fd_) + ": tee failed", true);
+        copied[i] = res > 0 ? res : 0;
+        complete = complete && copied[i] == n;
+    }
+
+    // 全部复制完整时，数据移到最后一个目标
+    size_t moved = 0;
+    while (complete && moved < n)
+    {
+        ssize_t res = splice(fd_, NULL, dsts.back()->fd_, NULL, n - moved, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+        if (res > 0)
+        {
+            moved += res;
+            continue;
+        }
+        // 写端已关闭，消息不完整
+        if (res == 0)
+            UtilError::error_exit("fd " + std::to_string(fd_) + ": EOF in the middle of splice", false);
+        if (res == -1 && errno != EAGAIN && errno != EINTR)
+            UtilError::error_exit("fd " + std::to_string(fd_) + ": splice failed", true);
+
+        // 还没有移动任何数据时改为读出补写；否则可能是来源暂时没有数据（写端分多次写入），也可能是目标已满，
+        // 等待来源可读、目标可写后继续，不空转
+        if (moved == 0)
+            complete = false;
+        else if (res == -1 && errno == EAGAIN)
+        {
+            wait_fd(fd_, POLLIN);
+            wait_fd(dsts.back()->fd_, POLLOUT);
+        }
+    }
+    if (complete)
+    {
+        Log::debug(std::to_string(n) + " bytes was forwarded from: " + std::to_string(fd_));
+        return true;
+    }
+
+    // 有目标没有复制完整：读出数据，补写每个目标缺少的部分
+    std::vector<char> buf(n);
+    read_all(fd_, buf.data(), n);
+    for (size_t i = 0; i < dsts.size(); i++)
+        write_all(dsts[i]->fd_, buf.data() + copied[i], n - copied[i]);
+
+    Log::debug(std::to_string(n) + " bytes was forwarded by copy from: " + std::to_string(fd_));
+    return true;
+}
+
 int FileDescriptor::closefile()
 {
     // 上锁
@@ -116,31 +387,53 @@ void FileDescriptor::writeline(std::string &s)
     writefile((void *)arr, s.size());
 }
 
+int FileDescriptor::fill_read_buffer()
+{
+    if (read_buf_.empty())
+        read_buf_.resize(READ_BUF_SIZE);
+
+    // 已取走的数据丢弃，剩下的移到开头
+    if (read_begin_ > 0)
+    {
+        memmove(read_buf_.data(), read_buf_.data() + read_begin_, read_end_ - read_begin_);
+        read_end_ -= read_begin_;
+        read_begin_ = 0;
+    }
+    // 一行比缓冲区长时扩容
+    if (read_end_ == read_buf_.size())
+        read_buf_.resize(read_buf_.size() * 2);
+
+    int res = readfile(read_buf_.data() + read_end_, read_buf_.size() - read_end_);
+    if (res > 0)
+        read_end_ += res;
+    return res;
+}
+
 std::string FileDescriptor::readline()
 {
-    char ch;
-    std::string result;
+    // 上锁
+    std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
 
-    while (true)
+    const char *line;
+    size_t n;
+    while (!next_line(line, n))
     {
-        // 一次读1字节
-        int num_bytes_read = readfile(&ch, 1);
+        // 一次读取一整块，而不是每个字节一次系统调用
+        int res = fill_read_buffer();
 
-        // EOF退出
-        if (num_bytes_read == 0)
+        // EOF，剩下的数据作为最后一行
+        if (res == 0)
         {
-            if (result.back() != '\n')
+            std::string result(read_buf_.data() + read_begin_, read_end_ - read_begin_);
+            read_begin_ = read_end_ = read_scanned_ = 0;
+            if (result.empty() || result.back() != '\n')
                 result += '\n';
-            break;
+            return result;
         }
 
-        // 非EOF
-        result += ch;
-
-        // 读到换行符
-        if (ch == '\n')
-            break;
+        // 非阻塞文件暂时没有完整的一行，已读到的部分留在缓冲区
+        if (res < 0)
+            return std::string();
     }
-
-    return result;
+    return std::string(line, n);
 }
\ No newline at end of file
@@ -2,11 +2,17 @@
 #define __FILE_DESCRIPTOR_H__
 
 #include <mutex>
+#include <algorithm>
+#include <string>
 #include <thread>
 #include <memory>
+#include <vector>
 
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 #include "src/utils/util.hpp"
 #include "src/log/Log.hpp"
@@ -28,6 +34,43 @@ protected:
     // 锁
     std::recursive_mutex file_operation_mutex_;
 
+    // 按行读取的缓冲区，一次从内核读取一整块，[read_begin_, read_end_)为还没取走的数据
+    // 其中前read_scanned_字节已经确认没有换行符，不需要重复查找
+    std::vector<char> read_buf_;
+    size_t read_begin_ = 0;
+    size_t read_end_ = 0;
+    size_t read_scanned_ = 0;
+    static const size_t READ_BUF_SIZE = 4096;
+
+    // 从缓冲区取出一行（包含换行符），没有完整的一行返回false
+    bool next_line(const char *&line, size_t &n)
+    {
+        const char *begin = read_buf_.data() + read_begin_;
+        size_t size = read_end_ - read_begin_;
+        // memchr一次比较多个字节（glibc使用SIMD实现）
+        const char *newline = (const char *)memchr(begin + read_scanned_, '\n', size - read_scanned_);
+        if (newline == NULL)
+        {
+            read_scanned_ = size;
+            return false;
+        }
+        line = begin;
+        n = newline - begin + 1;
+        read_begin_ += n;
+        read_scanned_ = 0;
+        return true;
+    }
+
+    // 从文件读取一块数据追加到缓冲区，返回值同readfile()
+    int fill_read_buffer();
+
+    // 把本文件（管道）开头的n字节转发到多个管道，每个目标先写入prefix
+    // use_splice为true且不小于forward_splice_min字节（默认4096）时不经过用户空间：除最后一个目标外用tee复制，
+    // 最后一个用splice移动，复制不完整时读出数据补写；否则读出后写入，每个目标一次写入
+    // 转发期间持有所有目标的锁，前缀与内容不会与本进程其他线程的写入交错
+    // 开始之前等待来源有n字节、目标放得下，最多等待timeout_ms毫秒，超时返回false；开始之后必须转发完整
+    bool splice_to(std::vector<FileDescriptor *> dsts, size_t n, const void *prefix, size_t prefix_len, int timeout_ms, bool use_splice);
+
     // 检查文件是否开启
     void check_file_open();
 
@@ -53,6 +96,30 @@ protected:
         return true;
     }
 
+    // 一次发送多条消息，每次写入整数条，合计不超过PIPE_BUF，管道保证消息不会被拆开或与其他写端交错
+    // 一条消息就超过PIPE_BUF时每次写一条，与send_struct相同
+    template <typename RetMsgStruct>
+    bool send_structs(const RetMsgStruct *msgs, size_t n)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+
+        size_t per_write = std::max<size_t>(1, PIPE_BUF / sizeof(RetMsgStruct));
+        for (size_t i = 0; i < n; i += per_write)
+        {
+            size_t bytes = std::min(per_write, n - i) * sizeof(RetMsgStruct);
+            int res = writefile((void *)(msgs + i), bytes);
+            check_write_result(res);
+
+            // 缺
+            if (res < bytes)
+            {
+                UtilError::error_exit("fd " + std::to_string(fd_) + ": number of bytes write is not euqal to number of RetMsgStruct", false);
+                return false;
+            }
+        }
+        return true;
+    }
+
     // 读端按照规定的协议读取消息，供读端使用
     template <typename RecvMsgStruct>
     bool recv_struct(RecvMsgStruct &in)
@@ -60,10 +127,10 @@ protected:
         RecvMsgStruct msg;
         int res = readfile(&msg, sizeof(RecvMsgStruct));
 
-        // EOF或错误检查
+        // EOF或错误检查，没有数据（EAGAIN）时返回false
         check_read_result(res);
-        if (res == 0)
-            return res;
+        if (res <= 0)
+            return false;
 
         // 缺
         if (res < sizeof(RecvMsgStruct))
@@ -86,8 +153,9 @@ public:
     FileDescriptor(FileOpenMode open_mode_);
     int get_fd();
 
-    virtual int readfile(void *buf, size_t n);  // 返回读取字节数，0表示EOF
+    virtual int readfile(void *buf, size_t n);  // 返回读取字节数，0表示EOF，-1表示非阻塞文件暂时没有数据
     virtual int writefile(void *buf, size_t n); // 返回写入字节数，0表示没写入
+    virtual int writevfile(const struct iovec *iov, int iovcnt); // 分散写，返回写入字节数
     virtual int closefile();                    // 关闭文件
     virtual int openfile() = 0;                 // 打开文件，不存在则创建，已打开则不操作
     virtual int createfile() = 0;               // 创建文件，存在则删除重新创建
@@ -95,7 +163,58 @@ public:
     virtual void eof_callback(int err) = 0;     // EOF时回调
     virtual void recv_callback() = 0;           // 有输入时回调
 
+    // 边缘触发时使用：能否一次读完所有数据。不支持的文件仍以水平触发监听
+    virtual bool can_drain() { return false; }
+    // 边缘触发时的回调：最多处理budget条消息，读到EAGAIN（数据已读完）返回true，预算用完返回false
+    virtual bool drain_callback(int budget)
+    {
+        recv_callback();
+        return true;
+    }
+    // 每条消息固定长度的文件返回消息字节数，监听器可以直接把消息读入自己的缓冲区（io_uring用），0表示不支持
+    virtual size_t record_size() { return 0; }
+    // 监听器已经读出一条完整的消息时回调，n为record_size()
+    virtual void recv_record_callback(const void *buf, size_t n) {}
+
+    // 按顺序发送iov中的所有记录，每个iovec是一条记录
+    // 相邻的记录合并为一次writev，合计不超过PIPE_BUF，记录不会被拆开或与其他写端交错
+    bool send_iov(const struct iovec *iov, int iovcnt);
+
     void writeline(std::string &s);             // 写一行字符串，保证以换行符结尾
-    std::string readline();                     // 读一行字符串，保证以换行符结尾
+    std::string readline();                     // 读一行字符串，保证以换行符结尾，非阻塞文件暂时没有完整的一行时返回空字符串
+
+    // 批量读行：缓冲区中没有完整的行时从文件读取一次，然后对每个完整的行调用on_line(line, n)
+    // line指向缓冲区内部（包含换行符），只在回调中有效，不复制数据。返回处理的行数
+    // EOF时剩下不完整的一行也会交给回调。读行使用的缓冲区会多读数据，同一个文件不要与readfile()混用
+    template <typename LineFunc>
+    int readlines(LineFunc on_line)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+
+        const char *line;
+        size_t n;
+        int count = 0;
+        while (next_line(line, n))
+        {
+            on_line(line, n);
+            count++;
+        }
+        if (count > 0)
+            return count;
+
+        // EOF时剩下的数据作为最后一行
+        if (fill_read_buffer() == 0 && read_end_ > read_begin_)
+        {
+            on_line(read_buf_.data() + read_begin_, read_end_ - read_begin_);
+            read_begin_ = read_end_ = read_scanned_ = 0;
+            return 1;
+        }
+        while (next_line(line, n))
+        {
+            on_line(line, n);
+            count++;
+        }
+        return count;
+    }
 };
 #endif // __FILE_DESCRIPTOR_H_
\ No newline at end of file
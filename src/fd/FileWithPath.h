@@ -23,6 +23,7 @@ public:
     // FileWithPath(const FileWithPath &) = delete;
     // FileWithPath &operator=(const FileWithPath &) = delete;
     FileWithPath(const std::string &s, FileOpenMode open_mode);
+    const std::string &get_path() { return path_; }
     int deletefile();
     int openfile();
 };
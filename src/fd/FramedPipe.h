@@ -0,0 +1,219 @@
+#ifndef __FRAMED_PIPE_H__
+#define __FRAMED_PIPE_H__
+
+#include <chrono>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include <poll.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "src/fd/NamedPipe.h"
+#include "src/config/ConfigReader.h"
+
+// 帧头，后面紧跟length字节的内容
+struct FrameHeader
+{
+    uint32_t type;
+    uint32_t length;
+};
+
+// 按帧收发的命名管道，每帧由帧头（类型、长度）与变长的内容组成
+// 读端：一次读取一整块放入缓冲区，不完整的帧留在缓冲区中，下次就绪时继续拼接，读取的长度不需要与消息对齐
+// 按类型调用设置的处理函数；支持一直读到EAGAIN，可以在边缘触发模式下使用
+// 写端：帧头与内容一次writev写出，不超过PIPE_BUF的帧是原子的；更大的帧在管道满时等待可写，
+// 同一进程内加锁保证不交错，但多个进程同时写超过PIPE_BUF的帧仍可能交错，这种管道应只有一个写端进程
+// 发送时管道已满会阻塞调用的线程并持有文件的锁：还没写出任何字节时最多等待frame_send_timeout毫秒（默认1000），超时返回false；
+// 已经写出一部分的帧必须写完，否则读端会错位，这时一直等到读端读走
+class FramedPipe : public NamedPipe<int, int>
+{
+public:
+    // 处理一帧的内容，payload只在回调中有效，且不保证对齐
+    using FrameFuncType = std::function<bool(const char *payload, size_t n)>;
+
+private:
+    std::unordered_map<uint32_t, FrameFuncType> frame_funcs_;
+    // 一帧内容的最大长度，超过时认为数据已损坏
+    size_t max_frame_size_;
+    // 管道已满、还没写出任何字节时等待可写的最长时间（毫秒）
+    int send_timeout_ms_;
+
+    // 从缓冲区取出一帧，没有完整的帧返回false
+    bool next_frame(FrameHeader &header, const char *&payload)
+    {
+        size_t size = read_end_ - read_begin_;
+        if (size < sizeof(FrameHeader))
+            return false;
+
+        memcpy(&header, read_buf_.data() + read_begin_, sizeof(FrameHeader));
+        if (header.length > max_frame_size_)
+        {
+            // 无法找到下一帧的开头，丢弃已读到的数据
+            Log::warn("frame of " + std::to_string(header.length) + " bytes from " + path_ + " exceeds frame_max_size, drop buffered data");
+            read_begin_ = read_end_ = 0;
+            return false;
+        }
+        if (size < sizeof(FrameHeader) + header.length)
+            return false;
+
+        payload = read_buf_.data() + read_begin_ + sizeof(FrameHeader);
+        read_begin_ += sizeof(FrameHeader) + header.length;
+        return true;
+    }
+
+    // 处理缓冲区中所有完整的帧
+    void process_frames()
+    {
+        FrameHeader header;
+        const char *payload;
+        while (next_frame(header, payload))
+        {
+            auto it = frame_funcs_.find(header.type);
+            if (it == frame_funcs_.end())
+            {
+                Log::warn("no process function for frame type " + std::to_string(header.type) + " from " + path_);
+                continue;
+            }
+            if (!it->second(payload, header.length))
+                Log::debug("process failed");
+        }
+    }
+
+public:
+    FramedPipe(const std::string &path, FileOpenMode open_mode)
+        : NamedPipe<int, int>(path, open_mode),
+          max_frame_size_(atoi(config::get("frame_max_size", "1048576").c_str())),
+          send_timeout_ms_(atoi(config::get("frame_send_timeout", "1000").c_str()))
+    {
+        if (max_frame_size_ == 0)
+            UtilError::error_exit("error frame_max_size setting", false);
+        if (send_timeout_ms_ < 0)
+            UtilError::error_exit("error frame_send_timeout setting", false);
+    }
+
+    // 设置某种类型的帧的处理函数，读端用
+    void set_frame_func(uint32_t type, FrameFuncType func) { frame_funcs_[type] = func; }
+
+    // 内容为固定结构体的帧，长度不符时丢弃
+    template <typename MsgStruct>
+    void set_msg_func(uint32_t type, std::function<bool(MsgStruct)> func)
+    {
+        frame_funcs_[type] = [this, type, func](const char *payload, size_t n) -> bool
+        {
+            if (n != sizeof(MsgStruct))
+            {
+                Log::warn("frame type " + std::to_string(type) + " from " + path_ + " has " + std::to_string(n) + " bytes, expect " + std::to_string(sizeof(MsgStruct)));
+                return false;
+            }
+            MsgStruct msg;
+            memcpy(&msg, payload, sizeof(MsgStruct));
+            return func(msg);
+        };
+    }
+
+    // 读取一次并处理所有完整的帧，返回值同readfile()
+    int recv_and_process()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        int res = fill_read_buffer();
+        process_frames();
+        return res;
+    }
+
+    // 有数据时读取一次
+    void recv_callback() { recv_and_process(); }
+    // 不完整的帧会留在缓冲区，可以一直读到EAGAIN
+    bool can_drain() { return true; }
+    // 边缘触发时连续读取，直到没有数据或预算用完，每次读取一块
+    bool drain_callback(int budget)
+    {
+        for (int i = 0; i < budget; i++)
+            if (recv_and_process() <= 0)
+                return true;
+        return false;
+    }
+    // 消息不是固定长度
+    size_t record_size() { return 0; }
+
+    // 设置管道已满时等待可写的最长时间（毫秒），0表示不等待
+    void set_send_timeout(int ms) { send_timeout_ms_ = ms; }
+
+    // 发送一帧，写端用；管道已满且等待超时（还没写出任何字节）时返回false，见类的注释
+    bool send_frame(uint32_t type, const void *payload, size_t n)
+    {
+        if (n > max_frame_size_)
+        {
+            Log::warn("frame of " + std::to_string(n) + " bytes to " + path_ + " exceeds frame_max_size");
+            return false;
+        }
+
+        FrameHeader header;
+        header.type = type;
+        header.length = n;
+        struct iovec iov[2];
+        iov[0].iov_base = &header;
+        iov[0].iov_len = sizeof(header);
+        iov[1].iov_base = (void *)payload;
+        iov[1].iov_len = n;
+
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        check_file_open();
+
+        struct iovec *cur = iov;
+        int cnt = n > 0 ? 2 : 1;
+        bool started = false;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(send_timeout_ms_);
+        while (cnt > 0)
+        {
+            int res = writev(fd_, cur, cnt);
+            if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // 管道已满，等待读端读走；已经写出一部分时必须写完
+                int timeout = -1;
+                if (!started)
+                {
+                    // 以时钟判断是否超时，剩余时间向上取整，避免提前放弃或超时后空转
+                    auto now = std::chrono::steady_clock::now();
+                    if (now >= deadline)
+                    {
+                        Log::warn("send frame to " + path_ + " timed out, reader does not read");
+                        return false;
+                    }
+                    timeout = (std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count() + 999) / 1000;
+                }
+                struct pollfd p;
+                p.fd = fd_;
+                p.events = POLLOUT;
+                poll(&p, 1, timeout);
+                continue;
+            }
+            if (res == -1 && errno == EINTR)
+                continue;
+            check_write_result(res);
+            started = true;
+
+            // 跳过已写出的部分
+            while (cnt > 0 && (size_t)res >= cur->iov_len)
+            {
+                res -= cur->iov_len;
+                cur++;
+                cnt--;
+            }
+            if (cnt > 0)
+            {
+                cur->iov_base = (char *)cur->iov_base + res;
+                cur->iov_len -= res;
+            }
+        }
+        Log::debug(std::to_string(sizeof(header) + n) + " bytes of frame was sent to: " + path_);
+        return true;
+    }
+
+    // 发送内容为固定结构体的帧
+    template <typename MsgStruct>
+    bool send_frame(uint32_t type, const MsgStruct &msg) { return send_frame(type, &msg, sizeof(MsgStruct)); }
+};
+
+#endif // __FRAMED_PIPE_H__
@@ -0,0 +1,207 @@
+#ifndef __MULTIPLEXED_PIPE_H__
+#define __MULTIPLEXED_PIPE_H__
+
+#include <tuple>
+#include <string>
+#include <vector>
+#include <functional>
+#include <type_traits>
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "src/fd/NamedPipe.h"
+
+// Msg在Msgs中的下标，不在其中时为sizeof...(Msgs)
+template <typename Msg, typename... Msgs>
+struct MsgIndex;
+template <typename Msg>
+struct MsgIndex<Msg>
+{
+    static const size_t value = 0;
+};
+template <typename Msg, typename... Rest>
+struct MsgIndex<Msg, Msg, Rest...>
+{
+    static const size_t value = 0;
+};
+template <typename Msg, typename First, typename... Rest>
+struct MsgIndex<Msg, First, Rest...>
+{
+    static const size_t value = 1 + MsgIndex<Msg, Rest...>::value;
+};
+
+// 多种协议共用的命名管道，每种消息是一个以protocal_type字段开头的固定结构体（比如model中的协议）
+// 读端：一次读取一整块放入缓冲区，按消息头的协议类型找到消息长度与处理函数，一次读取可以处理多条不同类型的消息
+// 分发用编译期按Msgs生成的跳转表，每种类型调用自己的处理函数，不需要手写switch；不完整的消息留到下次就绪时补全
+// 写端：每条消息一次写入，不超过PIPE_BUF，多个写端进程（比如所有客户端）共用一个管道也不会交错
+// 消息没有长度与校验字段，未知的协议类型无法确定下一条消息的开头，与FramedPipe一样丢弃缓冲区中已读到的数据（记录日志）
+// 不逐字节寻找下一个可识别的类型：填充的0等数据也会被当成合法的类型，读端会一直错位
+// 注意管道由所有写端共用：丢弃的数据中可能有其他写端的消息；之后的读取不一定从消息开头开始，可能要再丢弃几次才能重新对齐
+template <typename... Msgs>
+class MultiplexedPipe : public NamedPipe<int, int>
+{
+    static_assert(sizeof...(Msgs) > 0, "MultiplexedPipe needs at least one message type");
+
+    typedef typename std::tuple_element<0, std::tuple<Msgs...>>::type FirstMsg;
+
+public:
+    // 协议类型，即每种消息开头的protocal_type字段
+    typedef decltype(FirstMsg::protocal_type) ProtocalType;
+
+private:
+    // 跳转表的一项：消息长度与处理函数
+    struct Entry
+    {
+        size_t size;
+        void (MultiplexedPipe::*dispatch)(const char *buf);
+    };
+    // 协议类型的取值范围，类型值直接作为下标查找跳转表
+    static const int MAX_PROTOCAL_TYPE = 256;
+
+    std::tuple<std::function<bool(Msgs)>...> process_funcs_;
+    // 协议类型对应的跳转表下标，-1表示不是本管道的消息
+    std::vector<int> slots_;
+
+    template <typename Msg>
+    static int check_msg()
+    {
+        static_assert(std::is_trivially_copyable<Msg>::value, "message must be trivially copyable");
+        static_assert(std::is_standard_layout<Msg>::value && offsetof(Msg, protocal_type) == 0,
+                      "message must begin with protocal_type");
+        static_assert(std::is_same<decltype(Msg::protocal_type), ProtocalType>::value,
+                      "all messages must use the same protocal_type");
+        static_assert(sizeof(Msg) <= PIPE_BUF, "message must fit in PIPE_BUF to be written atomically");
+        return 0;
+    }
+
+    // 把缓冲区中的一条消息复制出来（缓冲区不保证对齐）交给对应的处理函数
+    template <typename Msg>
+    void dispatch(const char *buf)
+    {
+        Msg msg;
+        memcpy(&msg, buf, sizeof(Msg));
+        auto &func = std::get<MsgIndex<Msg, Msgs...>::value>(process_funcs_);
+        if (!func)
+        {
+            Log::warn("no process function for protocal type " + std::to_string((int)msg.protocal_type) + " from " + path_);
+            return;
+        }
+        if (!func(msg))
+            Log::debug("process failed");
+        else
+            Log::debug("process success");
+    }
+
+    static const Entry *table()
+    {
+        static const Entry entries[] = {{sizeof(Msgs), &MultiplexedPipe::dispatch<Msgs>}...};
+        return entries;
+    }
+
+    // 处理缓冲区中所有完整的消息，返回处理的消息数
+    int process_msgs()
+    {
+        int count = 0;
+        while (read_end_ - read_begin_ >= sizeof(ProtocalType))
+        {
+            const char *buf = read_buf_.data() + read_begin_;
+            ProtocalType type;
+            memcpy(&type, buf, sizeof(ProtocalType));
+            int slot = (int)type >= 0 && (int)type < (int)slots_.size() ? slots_[(int)type] : -1;
+            if (slot < 0)
+            {
+                // 无法找到下一条消息的开头，丢弃已读到的数据
+                Log::warn("unknown protocal type " + std::to_string((int)type) + " from " + path_ + ", drop " +
+                          std::to_string(read_end_ - read_begin_) + " buffered bytes");
+                read_begin_ = read_end_ = 0;
+                break;
+            }
+
+            const Entry &entry = table()[slot];
+            if (read_end_ - read_begin_ < entry.size)
+                break;
+            read_begin_ += entry.size;
+            (this->*entry.dispatch)(buf);
+            count++;
+        }
+        return count;
+    }
+
+public:
+    MultiplexedPipe(const std::string &path, FileOpenMode open_mode)
+        : NamedPipe<int, int>(path, open_mode)
+    {
+        int checks[] = {check_msg<Msgs>()...};
+        (void)checks;
+
+        // 协议类型取自每种消息默认初始化的protocal_type字段
+        ProtocalType types[] = {Msgs().protocal_type...};
+        for (size_t i = 0; i < sizeof...(Msgs); i++)
+        {
+            int type = (int)types[i];
+            if (type < 0 || type >= MAX_PROTOCAL_TYPE)
+                UtilError::error_exit("protocal type " + std::to_string(type) + " out of range", false);
+            if ((int)slots_.size() <= type)
+                slots_.resize(type + 1, -1);
+            if (slots_[type] != -1)
+                UtilError::error_exit("duplicate protocal type " + std::to_string(type) + " in " + path_, false);
+            slots_[type] = i;
+        }
+    }
+
+    // 设置某种消息的处理函数，读端用，模板参数需要显式给出
+    template <typename Msg>
+    void set_process_func(std::function<bool(Msg)> func)
+    {
+        static_assert(MsgIndex<Msg, Msgs...>::value < sizeof...(Msgs), "message type is not handled by this pipe");
+        std::get<MsgIndex<Msg, Msgs...>::value>(process_funcs_) = func;
+    }
+
+    // 读取一次并处理所有完整的消息，返回值同readfile()
+    int recv_and_process()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        int res = fill_read_buffer();
+        process_msgs();
+        return res;
+    }
+
+    // 有数据时读取一次
+    void recv_callback() { recv_and_process(); }
+    // 不完整的消息会留在缓冲区，可以一直读到EAGAIN
+    bool can_drain() { return true; }
+    // 边缘触发时连续读取处理，直到没有数据或预算用完
+    bool drain_callback(int budget)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        int done = 0;
+        while (done < budget)
+        {
+            int res = fill_read_buffer();
+            done += process_msgs();
+            if (res <= 0)
+                return true;
+        }
+        return false;
+    }
+    // 消息长度取决于类型
+    size_t record_size() { return 0; }
+
+    // 发送一条消息，写端用
+    template <typename Msg>
+    bool send_msg(const Msg &msg)
+    {
+        static_assert(MsgIndex<Msg, Msgs...>::value < sizeof...(Msgs), "message type is not handled by this pipe");
+        return send_struct<Msg>(msg);
+    }
+    // 一次发送多条同类型的消息，合并为尽量少的写入，写端用
+    template <typename Msg>
+    bool send_many(const std::vector<Msg> &msgs)
+    {
+        static_assert(MsgIndex<Msg, Msgs...>::value < sizeof...(Msgs), "message type is not handled by this pipe");
+        return send_structs<Msg>(msgs.data(), msgs.size());
+    }
+};
+
+#endif // __MULTIPLEXED_PIPE_H__
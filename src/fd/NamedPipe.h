@@ -2,8 +2,12 @@
 #define __NAMED_PIPE_H__
 
 #include <string>
+#include <vector>
 #include <functional>
 #include <memory>
+#include <algorithm>
+
+#include <stdint.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,6 +15,7 @@
 #include <unistd.h>
 
 #include "src/fd/FileWithPath.h"
+#include "src/config/ConfigReader.h"
 
 // 命名管道
 // 两个模板参数分别为读与写的协议
@@ -22,9 +27,75 @@ private:
     // 传入为RecvMsgStruct
     // 函数内容为处理接收到的消息
     using ProcFuncType = std::function<bool(RecvMsgStruct)>;
+    // 批量处理函数，msgs为一次读到的n条完整的消息，只在回调中有效
+    using BatchFuncType = std::function<bool(const RecvMsgStruct *msgs, size_t n)>;
     ProcFuncType process_func_;
+    BatchFuncType batch_func_;
     bool has_process_func_ = false;
 
+    // 批量读取的缓冲区，一次read()最多读batch_size_条消息，按消息类型对齐
+    // 前batch_partial_字节是上次读到的不完整的消息（比如写端一次写入超过PIPE_BUF被拆开），下次读取时补全
+    std::vector<RecvMsgStruct> batch_buf_;
+    size_t batch_size_ = 0;
+    size_t batch_partial_ = 0;
+
+    // 转发时等待的最长时间（毫秒）与是否使用splice，小于0表示第一次转发时从配置读取
+    int forward_timeout_ms_ = -1;
+    int forward_splice_ = -1;
+
+    // 转发的设置
+    void init_forward()
+    {
+        if (forward_timeout_ms_ < 0)
+            set_forward_timeout(atoi(config::get("forward_timeout", "1000").c_str()));
+        if (forward_splice_ < 0)
+            forward_splice_ = config::get("forward_splice", "false") == "true";
+    }
+
+    // 一次读取最多max条消息并处理，返回处理的消息数，没有数据可读时返回-1
+    int recv_batch(size_t max)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (batch_size_ == 0)
+            set_batch_size(atoi(config::get("recv_batch_size", "32").c_str()));
+
+        char *buf = (char *)batch_buf_.data();
+        size_t want = std::min(max, batch_size_) * sizeof(RecvMsgStruct);
+        int res = readfile(buf + batch_partial_, want - batch_partial_);
+        if (res <= 0)
+        {
+            // 写端关闭，不完整的消息不会再补全
+            if (res == 0)
+                batch_partial_ = 0;
+            return -1;
+        }
+
+        size_t bytes = batch_partial_ + res;
+        size_t n = bytes / sizeof(RecvMsgStruct);
+        batch_partial_ = bytes % sizeof(RecvMsgStruct);
+        if (n > 0)
+            process_batch(batch_buf_.data(), n);
+        if (batch_partial_ > 0)
+            memmove(buf, buf + n * sizeof(RecvMsgStruct), batch_partial_);
+        return n;
+    }
+
+    // 有批量处理函数时一次处理，否则逐条调用处理函数
+    void process_batch(const RecvMsgStruct *msgs, size_t n)
+    {
+        if (!batch_func_)
+        {
+            for (size_t i = 0; i < n; i++)
+                process(msgs[i]);
+            return;
+        }
+
+        if (!batch_func_(msgs, n))
+            Log::debug("process failed");
+        else
+            Log::debug("process " + std::to_string(n) + " messages success");
+    }
+
 public:
     // NamedPipe(const NamedPipe &) = delete;
     // NamedPipe &operator=(const NamedPipe &) = delete;
@@ -85,22 +156,46 @@ public:
     bool recv_msg(RecvMsgStruct &msg) { return recv_struct<RecvMsgStruct>(msg); }
     // 发送协议，写端用
     bool send_msg(RetMsgStruct msg) { return send_struct<RetMsgStruct>(msg); }
-    // 接收到内容时的处理函数，供读端使用
-    void recv_callback()
+    // 一次发送多条消息，合并为尽量少的写入，写端用
+    bool send_many(const RetMsgStruct *msgs, size_t n) { return send_structs<RetMsgStruct>(msgs, n); }
+    bool send_many(const std::vector<RetMsgStruct> &msgs) { return send_many(msgs.data(), msgs.size()); }
+    // 把管道开头的n字节（比如一条消息的剩余部分）转发到其他管道（比如接收者的管道），写端需要是管道
+    // 每个目标先写入prefix（比如已经读出用于路由的消息头），多个目标时每个都收到一份
+    // 默认读出后写入；开启forward_splice且不小于forward_splice_min字节时数据不经过用户空间
+    // 来源不到n字节或目标放不下时最多等待forward_timeout毫秒，超时返回false，管道中的数据不变
+    // 转发的数据不经过读行的缓冲区，不要与readline()混用
+    bool forward_to(FileDescriptor &dst, size_t n, const void *prefix = NULL, size_t prefix_len = 0)
+    {
+        return forward_to(std::vector<FileDescriptor *>(1, &dst), n, prefix, prefix_len);
+    }
+    bool forward_to(const std::vector<FileDescriptor *> &dsts, size_t n, const void *prefix = NULL, size_t prefix_len = 0)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        init_forward();
+        return splice_to(dsts, n, prefix, prefix_len, forward_timeout_ms_, forward_splice_);
+    }
+    // 设置转发时等待的最长时间（毫秒），0表示不等待
+    void set_forward_timeout(int ms)
+    {
+        if (ms < 0)
+            UtilError::error_exit("error forward_timeout setting", false);
+        forward_timeout_ms_ = ms;
+    }
+    // 设置转发是否使用tee/splice，默认读出后写入（小消息与大多数情况下更快）
+    void set_forward_splice(bool use_splice) { forward_splice_ = use_splice; }
+    // 一次读取最多batch_size条消息并处理，没有数据可读时返回false
+    // 读取使用自己的缓冲区，可能留下不完整的消息，设置了处理函数的读端不要再用recv_msg()读取
+    bool recv_and_process()
     {
         // 未定义处理函数
         if (!has_process_func_)
             UtilError::error_exit("namedpipe: process function not defined", false);
 
-        // 接收
-        RecvMsgStruct received_msg;
-        bool recv_sucess = recv_msg(received_msg);
-
-        // 接收失败
-        if (!recv_sucess)
-            return;
-
-        // 调用用户定义的处理函数
+        return recv_batch(batch_size_ == 0 ? SIZE_MAX : batch_size_) >= 0;
+    }
+    // 调用用户定义的处理函数
+    void process(const RecvMsgStruct &received_msg)
+    {
         bool proc_success = process_func_(received_msg);
 
         // 处理失败
@@ -113,12 +208,59 @@ public:
         // 处理成功
         Log::debug("process success");
     }
-    // 设置处理函数，读端用
+    // 接收到内容时的处理函数，供读端使用
+    void recv_callback() { recv_and_process(); }
+    // 管道以非阻塞方式打开，可以一直读到EAGAIN
+    // 只有使用处理函数的读端才能连续读取，重写了recv_callback()的子类仍然一次一条
+    bool can_drain() { return has_process_func_; }
+    // 边缘触发时连续读取处理，直到没有数据或预算用完，每次读取不超过剩下的预算
+    bool drain_callback(int budget)
+    {
+        int done = 0;
+        while (done < budget)
+        {
+            int n = recv_batch(budget - done);
+            if (n < 0)
+                return true;
+            done += n;
+        }
+        return false;
+    }
+    // 消息固定为RecvMsgStruct，监听器可以直接读出整条消息
+    size_t record_size() { return has_process_func_ ? sizeof(RecvMsgStruct) : 0; }
+    // 监听器读出一条消息后调用处理函数
+    void recv_record_callback(const void *buf, size_t n)
+    {
+        RecvMsgStruct received_msg;
+        memcpy(&received_msg, buf, sizeof(RecvMsgStruct));
+        process_batch(&received_msg, 1);
+    }
+    // 设置处理函数，读端用，每条消息调用一次
     void set_process_func(ProcFuncType process_func)
     {
         process_func_ = process_func;
         has_process_func_ = true;
     }
+    // 设置批量处理函数，读端用，每次读取调用一次，代替逐条的处理函数
+    // 一次读取的消息数由配置项recv_batch_size决定（默认32），也可以用set_batch_size()设置
+    void set_batch_process_func(BatchFuncType batch_func)
+    {
+        batch_func_ = batch_func;
+        has_process_func_ = true;
+    }
+    // 设置一次读取最多的消息数，为1时与逐条读取相同
+    void set_batch_size(size_t batch_size)
+    {
+        if (batch_size == 0)
+            UtilError::error_exit("error recv_batch_size setting", false);
+
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        std::vector<RecvMsgStruct> buf(batch_size);
+        if (batch_partial_ > 0)
+            memcpy((void *)buf.data(), (void *)batch_buf_.data(), batch_partial_);
+        batch_buf_.swap(buf);
+        batch_size_ = batch_size;
+    }
 };
 
 // 只读命名管道
@@ -0,0 +1,438 @@
+#ifndef __SEQ_PACKET_SOCKET_H__
+#define __SEQ_PACKET_SOCKET_H__
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "src/fd/FileWithPath.h"
+#include "src/mux/FilesListener.h"
+#include "src/config/ConfigReader.h"
+
+// Unix域套接字的地址，路径太长时返回false
+inline bool seqpacket_address(const std::string &path, struct sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+    {
+        Log::warn("socket path " + path + " is too long");
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Unix域SOCK_SEQPACKET连接，收发与命名管道相同的协议结构体，两个模板参数分别为读与写的协议
+// 每次发送是一个完整的数据包，任意大小（不超过套接字缓冲区）都不会被拆开或与其他写端交错
+// 服务端由SeqPacketListener接受得到，客户端用路径构造，openfile()时连接
+// 读取时一次recvmmsg()最多读recv_batch_size条消息（默认32）
+// 发送时对端的接收缓冲区已满则等待可写，最多等待seqpacket_send_timeout毫秒（默认1000），超时返回false（对端太慢，消息丢弃）
+// 对端关闭时调用设置的关闭函数；通过watch()加入监听器的连接同时从监听器中删除并关闭
+template <typename RecvMsgStruct, typename RetMsgStruct>
+class SeqPacketConnection : public FileWithPath,
+                            public std::enable_shared_from_this<SeqPacketConnection<RecvMsgStruct, RetMsgStruct>>
+{
+public:
+    using ProcFuncType = std::function<bool(RecvMsgStruct)>;
+    using CloseFuncType = std::function<void()>;
+
+private:
+    ProcFuncType process_func_;
+    CloseFuncType close_func_;
+    FilesListener *files_listener_ = NULL;
+    // 对端已关闭
+    std::atomic<bool> closed_{false};
+    // 发送用的锁，与读取互不影响：发送等待可写时，同一连接的读取（比如对端的回复）仍可以进行
+    std::mutex send_mutex_;
+    // 发送时等待可写的最长时间（毫秒），等待期间持有send_mutex_、占用调用的线程（比如线程池的工作线程）
+    int send_timeout_ms_;
+
+    // recvmmsg()用，每条消息一个缓冲区
+    std::vector<RecvMsgStruct> batch_buf_;
+    std::vector<struct iovec> iovs_;
+    std::vector<struct mmsghdr> hdrs_;
+
+    void prepare_batch()
+    {
+        if (!batch_buf_.empty())
+            return;
+        int batch_size = atoi(config::get("recv_batch_size", "32").c_str());
+        if (batch_size <= 0)
+            UtilError::error_exit("error recv_batch_size setting", false);
+
+        batch_buf_.resize(batch_size);
+        iovs_.resize(batch_size);
+        hdrs_.resize(batch_size);
+        for (int i = 0; i < batch_size; i++)
+        {
+            iovs_[i].iov_base = &batch_buf_[i];
+            iovs_[i].iov_len = sizeof(RecvMsgStruct);
+            memset(&hdrs_[i], 0, sizeof(struct mmsghdr));
+            hdrs_[i].msg_hdr.msg_iov = &iovs_[i];
+            hdrs_[i].msg_hdr.msg_iovlen = 1;
+        }
+    }
+
+    // 对端关闭：从监听器中删除并关闭，调用关闭函数
+    void peer_closed()
+    {
+        if (closed_)
+            return;
+        closed_ = true;
+        Log::info("connection " + std::to_string(fd_) + " on " + path_ + " is closed by peer");
+
+        if (files_listener_ == NULL)
+            closefile();
+        else
+        {
+            // 在监听器的循环中删除，删除前不关闭fd，避免fd号被重用
+            auto self = this->shared_from_this();
+            FilesListener *listener = files_listener_;
+            listener->post(Task([listener, self]()
+                                {
+                                    listener->remove_fd(self);
+                                    self->closefile();
+                                }));
+        }
+        if (close_func_)
+            close_func_();
+    }
+
+    // 一次读取最多max条消息并处理，返回读到的消息数，没有数据或已关闭时返回-1
+    int recv_batch(size_t max)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (closed_)
+            return -1;
+        check_file_open();
+        prepare_batch();
+
+        unsigned int vlen = std::min(max, batch_buf_.size());
+        int res = recvmmsg(fd_, hdrs_.data(), vlen, MSG_DONTWAIT, NULL);
+        if (res == -1)
+        {
+            if (errno == EINTR)
+                return 0;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                Log::warn("recv from connection " + std::to_string(fd_) + " failed: " + std::string(strerror(errno)));
+                peer_closed();
+            }
+            return -1;
+        }
+
+        for (int i = 0; i < res; i++)
+        {
+            // 对端关闭时读到长度为0的消息
+            if (hdrs_[i].msg_len == 0)
+            {
+                peer_closed();
+                return -1;
+            }
+            if (hdrs_[i].msg_len != sizeof(RecvMsgStruct) || (hdrs_[i].msg_hdr.msg_flags & MSG_TRUNC))
+            {
+                Log::warn("drop packet of wrong size from connection " + std::to_string(fd_) + " on " + path_);
+                continue;
+            }
+            process(batch_buf_[i]);
+        }
+        return res;
+    }
+
+    void init_send_timeout()
+    {
+        send_timeout_ms_ = atoi(config::get("seqpacket_send_timeout", "1000").c_str());
+        if (send_timeout_ms_ < 0)
+            UtilError::error_exit("error seqpacket_send_timeout setting", false);
+    }
+
+    void process(const RecvMsgStruct &msg)
+    {
+        if (!process_func_)
+            UtilError::error_exit("seqpacket: process function not defined", false);
+        if (!process_func_(msg))
+            Log::debug("process failed");
+    }
+
+public:
+    // 客户端：连接path上的SeqPacketListener，openfile()时连接
+    SeqPacketConnection(const std::string &path)
+        : FileWithPath(path, FileOpenMode::ReadAndWrite) { init_send_timeout(); }
+
+    // 服务端：已经接受的连接，fd需要是非阻塞的
+    SeqPacketConnection(int fd, const std::string &path)
+        : FileWithPath(path, FileOpenMode::ReadAndWrite)
+    {
+        fd_ = fd;
+        is_open_ = true;
+        init_send_timeout();
+    }
+
+    // 连接服务端，已连接则不操作
+    int openfile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (is_open_)
+            return 1;
+
+        struct sockaddr_un addr;
+        if (!seqpacket_address(path_, addr))
+            UtilError::error_exit("connect " + path_ + " fail", false);
+        fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd_ == -1)
+            UtilError::error_exit("create socket fail", true);
+        if (connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+            UtilError::error_exit("connect " + path_ + " fail", true);
+        // 连接后再设为非阻塞，不需要处理连接中的状态
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+
+        is_open_ = true;
+        closed_ = false;
+        Log::debug("connect " + path_ + " success with fd " + std::to_string(fd_));
+        return 1;
+    }
+    // 套接字文件属于SeqPacketListener，连接不创建、不删除
+    int createfile() { return 1; }
+    int deletefile() { return 1; }
+    // 不通过readfile()读取，对端关闭由recv_batch()处理
+    void eof_callback(int err) { peer_closed(); }
+
+    // 加入监听器，消息到达时调用处理函数，对端关闭时自动删除；可以在任意线程调用
+    // 需要由共享指针持有
+    void watch(FilesListener *listener)
+    {
+        openfile();
+        files_listener_ = listener;
+        auto self = this->shared_from_this();
+        listener->post(Task([listener, self]()
+                            { listener->add_fd(self); }));
+    }
+
+    // 发送一个数据包，缓冲区已满时等待可写，对端已关闭、出错或等待超时时返回false
+    bool send_packet(const void *buf, size_t n)
+    {
+        if (closed_)
+            return false;
+        check_file_open();
+        std::lock_guard<std::mutex> lock(send_mutex_);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(send_timeout_ms_);
+        while (true)
+        {
+            int res = send(fd_, buf, n, MSG_NOSIGNAL);
+            if (res >= 0)
+                return true;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // 对端的接收缓冲区已满，等待读走
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline)
+                {
+                    Log::warn("send to connection " + std::to_string(fd_) + " on " + path_ + " timed out, peer does not read");
+                    return false;
+                }
+                // 剩余时间向上取整，是否超时只看时钟
+                struct pollfd p;
+                p.fd = fd_;
+                p.events = POLLOUT;
+                poll(&p, 1, (std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count() + 999) / 1000);
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            Log::warn("send to connection " + std::to_string(fd_) + " on " + path_ + " failed: " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+
+    // 设置发送时等待可写的最长时间（毫秒），0表示不等待
+    void set_send_timeout(int ms) { send_timeout_ms_ = ms; }
+
+    // 发送协议
+    bool send_msg(const RetMsgStruct &msg) { return send_packet(&msg, sizeof(RetMsgStruct)); }
+
+    // 接收一条消息，没有消息时返回false，不使用监听器时用
+    bool recv_msg(RecvMsgStruct &msg)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (closed_)
+            return false;
+        check_file_open();
+
+        while (true)
+        {
+            int res = recv(fd_, &msg, sizeof(RecvMsgStruct), MSG_DONTWAIT | MSG_TRUNC);
+            if (res == -1 && errno == EINTR)
+                continue;
+            if (res == -1)
+                return false;
+            if (res == 0)
+            {
+                peer_closed();
+                return false;
+            }
+            if (res == sizeof(RecvMsgStruct))
+                return true;
+            Log::warn("drop packet of wrong size from connection " + std::to_string(fd_) + " on " + path_);
+        }
+    }
+
+    // 有消息时读取一批并处理
+    void recv_callback() { recv_batch(SIZE_MAX); }
+    // 非阻塞，可以一直读到EAGAIN
+    bool can_drain() { return true; }
+    bool drain_callback(int budget)
+    {
+        int done = 0;
+        while (done < budget)
+        {
+            int n = recv_batch(budget - done);
+            if (n < 0)
+                return true;
+            done += n;
+        }
+        return false;
+    }
+
+    // 设置处理函数
+    void set_process_func(ProcFuncType process_func) { process_func_ = process_func; }
+    // 设置对端关闭时的回调
+    void set_close_func(CloseFuncType close_func) { close_func_ = close_func; }
+    // 对端是否已关闭
+    bool is_closed() { return closed_; }
+};
+
+// Unix域SOCK_SEQPACKET的监听套接字，加入监听器后接受连接，每个客户端一个双向的连接
+// 接受的连接自动加入同一个监听器，消息到达时以连接与消息调用处理函数，处理函数可以直接通过连接回复
+// 不需要为每个客户端打开回复管道；对端关闭时连接自动删除，并调用关闭函数
+template <typename RecvMsgStruct, typename RetMsgStruct>
+class SeqPacketListener : public FileWithPath
+{
+public:
+    using Connection = SeqPacketConnection<RecvMsgStruct, RetMsgStruct>;
+    using ConnFuncType = std::function<bool(std::shared_ptr<Connection>, RecvMsgStruct)>;
+    using AcceptFuncType = std::function<void(std::shared_ptr<Connection>)>;
+
+private:
+    FilesListener *files_listener_;
+    ConnFuncType process_func_;
+    AcceptFuncType accept_func_;
+    AcceptFuncType close_func_;
+
+    // 接受一个连接，没有等待的连接时返回false
+    bool accept_one()
+    {
+        int fd = accept4(fd_, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                Log::warn("accept on " + path_ + " failed: " + std::string(strerror(errno)));
+            return errno == EINTR;
+        }
+
+        auto conn = std::make_shared<Connection>(fd, path_);
+        std::weak_ptr<Connection> weak = conn;
+        ConnFuncType process_func = process_func_;
+        conn->set_process_func([weak, process_func](RecvMsgStruct msg) -> bool
+                               {
+                                   auto c = weak.lock();
+                                   return c && process_func(c, msg);
+                               });
+        AcceptFuncType close_func = close_func_;
+        if (close_func)
+            conn->set_close_func([weak, close_func]()
+                                 {
+                                     auto c = weak.lock();
+                                     if (c)
+                                         close_func(c);
+                                 });
+
+        if (accept_func_)
+            accept_func_(conn);
+        conn->watch(files_listener_);
+        Log::debug("accept connection " + std::to_string(fd) + " on " + path_);
+        return true;
+    }
+
+public:
+    // 接受的连接加入files_listener
+    SeqPacketListener(const std::string &path, FilesListener *files_listener)
+        : FileWithPath(path, FileOpenMode::ReadOnly), files_listener_(files_listener) {}
+
+    // 删除已存在的套接字文件，监听时重新创建
+    int createfile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (file_exits())
+        {
+            Log::warn("socket file exists, delete and create again");
+            FileWithPath::deletefile();
+        }
+        return 1;
+    }
+
+    // 创建套接字并开始监听，已监听则不操作
+    int openfile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (is_open_)
+            return 1;
+        if (!process_func_)
+            UtilError::error_exit("seqpacket: process function not defined", false);
+
+        struct sockaddr_un addr;
+        if (!seqpacket_address(path_, addr))
+            UtilError::error_exit("listen on " + path_ + " fail", false);
+        fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ == -1)
+            UtilError::error_exit("create socket fail", true);
+        if (bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+            UtilError::error_exit("bind " + path_ + " fail", true);
+        int backlog = atoi(config::get("seqpacket_backlog", "128").c_str());
+        if (listen(fd_, backlog) == -1)
+            UtilError::error_exit("listen on " + path_ + " fail", true);
+
+        is_open_ = true;
+        Log::debug("listen on " + path_ + " success with fd " + std::to_string(fd_));
+        return 1;
+    }
+
+    void eof_callback(int err) {}
+
+    // 有连接到达时接受所有等待的连接
+    void recv_callback()
+    {
+        while (accept_one())
+            ;
+    }
+    // 非阻塞，可以一直接受到EAGAIN
+    bool can_drain() { return true; }
+    bool drain_callback(int budget)
+    {
+        for (int i = 0; i < budget; i++)
+            if (!accept_one())
+                return true;
+        return false;
+    }
+
+    // 设置处理函数，需要在监听之前设置
+    void set_process_func(ConnFuncType process_func) { process_func_ = process_func; }
+    // 设置接受连接时的回调（比如设置连接的其他参数），在连接加入监听器之前调用
+    void set_accept_func(AcceptFuncType accept_func) { accept_func_ = accept_func; }
+    // 设置连接被对端关闭时的回调（比如用户下线）
+    void set_close_func(AcceptFuncType close_func) { close_func_ = close_func; }
+};
+
+#endif // __SEQ_PACKET_SOCKET_H__
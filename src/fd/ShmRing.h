@@ -0,0 +1,345 @@
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "src/fd/FileWithPath.h"
+#include "src/config/ConfigReader.h"
+
+// 共享内存环形队列的头部，放在共享内存的开头，后面紧跟capacity个槽
+// 生产者与消费者各自修改的下标放在不同的缓存行，避免互相使缓存失效
+struct ShmRingHeader
+{
+    uint32_t magic;
+    uint32_t slot_size;
+    uint64_t capacity;
+    // 下一个写入的位置，只有生产者修改
+    alignas(64) std::atomic<uint64_t> head;
+    // 下一个读取的位置，只有消费者修改
+    alignas(64) std::atomic<uint64_t> tail;
+    // 消费者没有消息可处理，正在等待门铃
+    alignas(64) std::atomic<uint32_t> idle;
+};
+
+// 基于共享内存的单生产者、单消费者环形队列，每个槽放一条MsgStruct
+// 消息直接写入共享内存，读端在共享内存中处理，不经过内核复制
+// 路径上是一个命名管道作为门铃，读端监听门铃，可以与命名管道一样加入监听器
+// 只有读端空闲（处理完所有消息）时写端才敲门铃，读端忙碌时发送消息不需要系统调用
+// 只读为消费者，只写为生产者；每个队列只能有一个生产者进程与一个消费者进程，同一进程内的多个线程由锁保证互斥
+template <typename MsgStruct>
+class ShmRing : public FileWithPath
+{
+    static_assert(std::is_trivially_copyable<MsgStruct>::value, "message in shared memory must be trivially copyable");
+
+public:
+    using ProcFuncType = std::function<bool(MsgStruct)>;
+    // 批量处理函数，msgs为共享内存中连续的n条消息，只在回调中有效
+    using BatchFuncType = std::function<bool(const MsgStruct *msgs, size_t n)>;
+
+private:
+    static const uint32_t MAGIC = 0x52494e47;
+
+    // 创建时的槽数
+    uint64_t capacity_;
+    ShmRingHeader *header_ = NULL;
+    MsgStruct *slots_ = NULL;
+    size_t map_size_ = 0;
+    // 本端缓存的对端下标，只有看起来已满（空）时才重新读取共享内存中的值
+    uint64_t cached_head_ = 0;
+    uint64_t cached_tail_ = 0;
+    // 写端敲门铃的次数
+    uint64_t doorbells_ = 0;
+
+    ProcFuncType process_func_;
+    BatchFuncType batch_func_;
+
+    // 共享内存的名字，由路径得到
+    std::string shm_name()
+    {
+        std::string name = path_;
+        std::replace(name.begin(), name.end(), '/', '_');
+        return "/" + name;
+    }
+
+    size_t shm_size(uint64_t capacity) { return sizeof(ShmRingHeader) + capacity * sizeof(MsgStruct); }
+
+    // 写端：读端空闲时敲门铃，同时清除空闲标记，读端再次空闲前不会重复敲
+    void notify()
+    {
+        if (header_->idle.load() == 0 || header_->idle.exchange(0) == 0)
+            return;
+        char c = 1;
+        if (write(fd_, &c, 1) == -1 && errno != EAGAIN)
+            Log::warn("ring doorbell of " + path_ + " failed: " + std::string(strerror(errno)));
+        doorbells_++;
+    }
+
+    // 读端：读走门铃中的数据
+    void clear_doorbell()
+    {
+        char buf[64];
+        while (read(fd_, buf, sizeof(buf)) > 0)
+            ;
+    }
+
+    // 读端：处理最多max条消息，返回处理的条数
+    size_t consume(size_t max)
+    {
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        size_t done = 0;
+        while (done < max)
+        {
+            if (tail == cached_head_)
+            {
+                cached_head_ = header_->head.load(std::memory_order_acquire);
+                if (tail == cached_head_)
+                    break;
+            }
+
+            // 一次处理连续的一段，不跨过环的末尾
+            size_t pos = tail & (capacity_ - 1);
+            size_t n = std::min<uint64_t>(std::min<uint64_t>(max - done, cached_head_ - tail), capacity_ - pos);
+            process(slots_ + pos, n);
+            tail += n;
+            done += n;
+            // 处理完才释放槽，写端不会覆盖正在处理的消息
+            header_->tail.store(tail, std::memory_order_release);
+        }
+        return done;
+    }
+
+    // 读端：标记空闲，之后写端会敲门铃；标记后再检查一次，避免与刚写入的写端互相错过
+    bool go_idle()
+    {
+        header_->idle.store(1);
+        if (header_->head.load() == header_->tail.load(std::memory_order_relaxed))
+            return true;
+        header_->idle.store(0, std::memory_order_relaxed);
+        return false;
+    }
+
+    // 收发不经过文件，只检查是否已映射，不需要check_file_open()的系统调用
+    void check_mapped()
+    {
+        if (header_ == NULL)
+            UtilError::error_exit("invalid shm ring operation without open!", false);
+    }
+
+    void process(const MsgStruct *msgs, size_t n)
+    {
+        if (batch_func_)
+        {
+            if (!batch_func_(msgs, n))
+                Log::debug("process failed");
+            return;
+        }
+        if (!process_func_)
+            UtilError::error_exit("shm ring: process function not defined", false);
+        for (size_t i = 0; i < n; i++)
+            if (!process_func_(msgs[i]))
+                Log::debug("process failed");
+    }
+
+public:
+    // capacity为创建时的槽数，必须是2的幂，0表示使用配置项shm_ring_capacity（默认1024）
+    // 打开已存在的队列时使用创建者的槽数
+    ShmRing(const std::string &path, FileOpenMode open_mode, uint64_t capacity = 0)
+        : FileWithPath(path, open_mode), capacity_(capacity)
+    {
+        if (open_mode == FileOpenMode::ReadAndWrite)
+            UtilError::error_exit("shm ring is either read only or write only", false);
+        if (capacity_ == 0)
+            capacity_ = atoll(config::get("shm_ring_capacity", "1024").c_str());
+        if (capacity_ == 0 || (capacity_ & (capacity_ - 1)) != 0)
+            UtilError::error_exit("shm ring capacity must be a power of 2", false);
+    }
+
+    // 创建门铃管道与共享内存，已存在则删除重新创建
+    int createfile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+
+        if (file_exits())
+        {
+            Log::warn("shm ring exists, delete and create again");
+            deletefile();
+        }
+        if (mkfifo(path_.c_str(), 0777) != 0)
+            UtilError::error_exit("create doorbell FIFO " + path_ + " failed", true);
+
+        int shm_fd = shm_open(shm_name().c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
+        if (shm_fd == -1)
+            UtilError::error_exit("create shared memory " + shm_name() + " failed", true);
+        size_t size = shm_size(capacity_);
+        if (ftruncate(shm_fd, size) != 0)
+            UtilError::error_exit("resize shared memory " + shm_name() + " failed", true);
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        close(shm_fd);
+        if (addr == MAP_FAILED)
+            UtilError::error_exit("map shared memory " + shm_name() + " failed", true);
+
+        ShmRingHeader *header = new (addr) ShmRingHeader();
+        header->slot_size = sizeof(MsgStruct);
+        header->capacity = capacity_;
+        header->head.store(0);
+        header->tail.store(0);
+        // 读端开始监听前写入的消息也需要敲门铃
+        header->idle.store(1);
+        header->magic = MAGIC;
+        munmap(addr, size);
+
+        Log::debug("shm ring " + path_ + " create success");
+        return 1;
+    }
+
+    // 打开门铃管道并映射共享内存，不存在则创建，已打开则不操作
+    int openfile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (is_open_)
+            return 1;
+        if (!file_exits())
+            createfile();
+        FileWithPath::openfile();
+
+        int shm_fd = shm_open(shm_name().c_str(), O_RDWR, 0);
+        if (shm_fd == -1)
+            UtilError::error_exit("open shared memory " + shm_name() + " failed", true);
+        struct stat st;
+        if (fstat(shm_fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRingHeader))
+            UtilError::error_exit("shared memory " + shm_name() + " is too small", false);
+        void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        close(shm_fd);
+        if (addr == MAP_FAILED)
+            UtilError::error_exit("map shared memory " + shm_name() + " failed", true);
+
+        header_ = (ShmRingHeader *)addr;
+        map_size_ = st.st_size;
+        if (header_->magic != MAGIC || header_->slot_size != sizeof(MsgStruct) || map_size_ < shm_size(header_->capacity))
+            UtilError::error_exit("shared memory " + shm_name() + " is not a ring of this message type", false);
+        capacity_ = header_->capacity;
+        slots_ = (MsgStruct *)(header_ + 1);
+        cached_head_ = header_->head.load();
+        cached_tail_ = header_->tail.load();
+        return 1;
+    }
+
+    // 取消映射并关闭门铃
+    int closefile()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (header_ != NULL)
+            munmap(header_, map_size_);
+        header_ = NULL;
+        slots_ = NULL;
+        return FileDescriptor::closefile();
+    }
+
+    // 删除门铃管道与共享内存，已经映射的一端仍可以使用
+    int deletefile()
+    {
+        FileWithPath::deletefile();
+        if (shm_unlink(shm_name().c_str()) != 0)
+            Log::warn("remove shared memory " + shm_name() + " failed: " + std::string(strerror(errno)));
+        return 1;
+    }
+
+    // 门铃以读写方式打开，不会EOF
+    void eof_callback(int err) { Log::warn("unexpected EOF on doorbell " + path_); }
+
+    // 发送一条消息，写端用，队列已满时返回false，由调用者决定重试或丢弃
+    bool send_msg(const MsgStruct &msg) { return send_many(&msg, 1) == 1; }
+
+    // 发送多条消息，只在最后更新一次下标、最多敲一次门铃，返回写入的条数，队列满时少于n
+    size_t send_many(const MsgStruct *msgs, size_t n)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        if (open_mode_ != FileOpenMode::WriteOnly)
+            UtilError::error_exit("attempt to send to read only shm ring", false);
+        check_mapped();
+
+        uint64_t head = header_->head.load(std::memory_order_relaxed);
+        if (head + n - cached_tail_ > capacity_)
+            cached_tail_ = header_->tail.load(std::memory_order_acquire);
+        n = std::min<uint64_t>(n, capacity_ - (head - cached_tail_));
+        if (n == 0)
+            return 0;
+
+        for (size_t i = 0; i < n; i++)
+            memcpy((void *)(slots_ + ((head + i) & (capacity_ - 1))), (const void *)(msgs + i), sizeof(MsgStruct));
+        // 写入下标与检查空闲标记之间需要全序，与读端的go_idle()配对
+        header_->head.store(head + n);
+        notify();
+        return n;
+    }
+
+    // 取出一条消息，读端不使用监听器时用，没有消息时返回false
+    bool recv_msg(MsgStruct &msg)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        check_mapped();
+
+        uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+        if (tail == cached_head_)
+        {
+            cached_head_ = header_->head.load(std::memory_order_acquire);
+            if (tail == cached_head_)
+                return false;
+        }
+        memcpy((void *)&msg, (const void *)(slots_ + (tail & (capacity_ - 1))), sizeof(MsgStruct));
+        header_->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 门铃响时处理所有消息，处理完后标记空闲
+    void recv_callback()
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        check_file_open();
+        clear_doorbell();
+        do
+            consume(SIZE_MAX);
+        while (!go_idle());
+    }
+
+    // 门铃以非阻塞方式打开，可以一直读到EAGAIN
+    bool can_drain() { return true; }
+    // 边缘触发时最多处理budget条消息，处理完所有消息后标记空闲
+    bool drain_callback(int budget)
+    {
+        std::unique_lock<std::recursive_mutex> lock(file_operation_mutex_);
+        check_file_open();
+        clear_doorbell();
+        size_t done = 0;
+        while (true)
+        {
+            done += consume(budget - done);
+            if (done >= (size_t)budget)
+                return false;
+            if (go_idle())
+                return true;
+        }
+    }
+
+    // 设置处理函数，读端用，每条消息调用一次
+    void set_process_func(ProcFuncType process_func) { process_func_ = process_func; }
+    // 设置批量处理函数，读端用，每段连续的消息调用一次，消息不复制
+    void set_batch_process_func(BatchFuncType batch_func) { batch_func_ = batch_func; }
+
+    // 槽数
+    uint64_t capacity() { return capacity_; }
+    // 写端敲门铃的次数
+    uint64_t doorbells() { return doorbells_; }
+};
+
+#endif // __SHM_RING_H__
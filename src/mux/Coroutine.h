@@ -0,0 +1,222 @@
+#ifndef __COROUTINE_H__
+#define __COROUTINE_H__
+
+#if __cplusplus < 202002L
+#error "src/mux/Coroutine.h requires -std=c++20"
+#endif
+
+#include <deque>
+#include <coroutine>
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "src/mux/FilesListenerEpoll.h"
+
+// 基于epoll监听器的协程接口（C++20），回调接口不受影响
+// 协程只在事件循环的线程中运行：管道可读、可写、定时器到期时由事件循环恢复，不会阻塞线程
+// 一个事件循环的线程可以同时驱动大量挂起中的请求流程
+// 监听器不能使用线程池（use_thread_pool为false），否则协程会在工作线程中恢复
+
+// 协程的返回类型，创建后立即执行到第一次挂起，结束时自动释放
+// 监听开始后应通过listener.post()在事件循环中创建，比如
+// listener.post([&]() { serve(listener, requests); });
+struct Coroutine
+{
+    struct promise_type
+    {
+        Coroutine get_return_object() { return Coroutine(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { UtilError::error_exit("unhandled exception in coroutine", false); }
+    };
+};
+
+// 可以等待消息的只读命名管道，co_await pipe.recv_msg() 得到下一条消息
+// 没有消息时挂起，等到可读再继续接收，多个协程等待时按等待的顺序得到消息
+// 只在有协程等待时才读取，读得慢时写端会被管道容量限制，不需要（也不能）加入监听器
+template <typename RecvMsgStruct>
+class AsyncReadFIFO : public ReadOnlyFIFO<RecvMsgStruct>
+{
+private:
+    struct RecvAwaiter;
+
+    FilesListenerEpoll &listener_;
+    // 等待消息的协程
+    std::deque<RecvAwaiter *> waiters_;
+
+    struct RecvAwaiter
+    {
+        AsyncReadFIFO *pipe;
+        RecvMsgStruct msg;
+        std::coroutine_handle<> handle;
+
+        // 前面没有等待的协程时直接读取，读到消息不挂起
+        bool await_ready() { return pipe->waiters_.empty() && pipe->try_recv(msg); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            handle = h;
+            pipe->waiters_.push_back(this);
+            if (pipe->waiters_.size() == 1)
+                pipe->wait_readable();
+        }
+        RecvMsgStruct await_resume() { return msg; }
+    };
+
+    // 非阻塞读取一条消息，没有消息返回false
+    bool try_recv(RecvMsgStruct &msg)
+    {
+        this->openfile();
+        return this->recv_msg(msg);
+    }
+
+    void wait_readable()
+    {
+        if (!listener_.wait_readable(this->get_fd(), Task([this]()
+                                                          { flush(); })))
+            UtilError::error_exit("async recv: wait readable failed", false);
+    }
+
+    // 管道可读时按顺序把消息交给等待的协程，读完还有协程等待则继续等待
+    void flush()
+    {
+        while (!waiters_.empty())
+        {
+            RecvAwaiter *waiter = waiters_.front();
+            if (!try_recv(waiter->msg))
+            {
+                wait_readable();
+                return;
+            }
+            waiters_.pop_front();
+            waiter->handle.resume();
+        }
+    }
+
+public:
+    AsyncReadFIFO(FilesListenerEpoll &listener, const std::string &path)
+        : ReadOnlyFIFO<RecvMsgStruct>(path), listener_(listener) {}
+
+    // 等待可读的回调持有this，关闭之前取消，否则fd号被重用时会在已释放的对象上执行
+    // 需要在事件循环的线程中析构，还在等待消息的协程不会再恢复
+    ~AsyncReadFIFO()
+    {
+        if (!waiters_.empty())
+            listener_.cancel_wait(this->get_fd());
+        if (this->is_open_)
+            this->closefile();
+    }
+
+    // 同步接收的接口仍然可用
+    using NamedPipe<RecvMsgStruct, int>::recv_msg;
+
+    // 等待下一条消息
+    RecvAwaiter recv_msg() { return RecvAwaiter{this}; }
+};
+
+// 可以等待发送完成的只写命名管道，co_await fifo.send_msg(msg)
+// 管道已满时挂起，等到可写再继续发送，同一个管道的消息按发送的顺序写入
+template <typename RetMsgStruct>
+class AsyncWriteFIFO : public WriteOnlyFIFO<RetMsgStruct>
+{
+private:
+    // 不超过PIPE_BUF的写入是原子的，要么整条写入，要么EAGAIN
+    static_assert(sizeof(RetMsgStruct) <= PIPE_BUF, "message larger than PIPE_BUF");
+
+    struct SendAwaiter;
+
+    FilesListenerEpoll &listener_;
+    // 管道已满时排队等待发送的协程
+    std::deque<SendAwaiter *> senders_;
+
+    struct SendAwaiter
+    {
+        AsyncWriteFIFO *fifo;
+        RetMsgStruct msg;
+        std::coroutine_handle<> handle;
+
+        // 前面没有排队的消息时直接写入，写入成功不挂起
+        bool await_ready() { return fifo->senders_.empty() && fifo->try_send(msg); }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            handle = h;
+            fifo->senders_.push_back(this);
+            if (fifo->senders_.size() == 1)
+                fifo->wait_writable();
+        }
+        void await_resume() {}
+    };
+
+    // 非阻塞写入一条消息，管道已满返回false
+    bool try_send(const RetMsgStruct &msg)
+    {
+        this->openfile();
+        int res = write(this->get_fd(), &msg, sizeof(RetMsgStruct));
+        if (res == sizeof(RetMsgStruct))
+            return true;
+        if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return false;
+        UtilError::error_exit("fd " + std::to_string(this->get_fd()) + ": async send failed", true);
+        return false;
+    }
+
+    void wait_writable()
+    {
+        if (!listener_.wait_writable(this->get_fd(), Task([this]()
+                                                          { flush(); })))
+            UtilError::error_exit("async send: wait writable failed", false);
+    }
+
+    // 管道可写时按顺序发送排队的消息，每发出一条恢复对应的协程，再次写满则继续等待
+    void flush()
+    {
+        while (!senders_.empty())
+        {
+            SendAwaiter *sender = senders_.front();
+            if (!try_send(sender->msg))
+            {
+                wait_writable();
+                return;
+            }
+            senders_.pop_front();
+            sender->handle.resume();
+        }
+    }
+
+public:
+    AsyncWriteFIFO(FilesListenerEpoll &listener, const std::string &path)
+        : WriteOnlyFIFO<RetMsgStruct>(path), listener_(listener) {}
+
+    // 等待可写的回调持有this，关闭之前取消，需要在事件循环的线程中析构，排队中的消息不再发送
+    ~AsyncWriteFIFO()
+    {
+        if (!senders_.empty())
+            listener_.cancel_wait(this->get_fd());
+        if (this->is_open_)
+            this->closefile();
+    }
+
+    // 发送消息，写入管道后继续（隐藏了同步的send_msg，不要混用，否则消息顺序无法保证）
+    SendAwaiter send_msg(const RetMsgStruct &msg) { return SendAwaiter{this, msg}; }
+};
+
+// 等待定时器，co_await async_sleep(listener, 100) 在100毫秒后继续，精度为timer_tick_ms
+struct SleepAwaiter
+{
+    FilesListener &listener;
+    uint64_t delay_ms;
+
+    bool await_ready() { return false; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        listener.timers().schedule(delay_ms, [h]()
+                                   { h.resume(); });
+    }
+    void await_resume() {}
+};
+
+inline SleepAwaiter async_sleep(FilesListener &listener, uint64_t delay_ms) { return SleepAwaiter{listener, delay_ms}; }
+
+#endif
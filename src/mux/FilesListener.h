@@ -2,42 +2,278 @@
 #define __FILE_LISTENER_H__
 
 #include <map>
+#include <mutex>
 #include <memory>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
 
 #include "src/ThreadPool/ThreadPool.hpp"
+#include "src/ThreadPool/Strand.hpp"
+#include "src/mux/TimerWheel.h"
 #include "src/config/ConfigReader.h"
 #include "src/fd/FileDescriptor.h"
 #include "src/fd/NamedPipe.h"
 
+// 文件的Strand，持有文件的共享指针
+// 排队中的回调只保存文件的裸指针，由Strand保证回调执行时文件仍然存活
+class FileStrand : public Strand
+{
+private:
+    std::shared_ptr<FileDescriptor> file_;
+
+public:
+    FileStrand(ThreadPool *pool, std::shared_ptr<FileDescriptor> file)
+        : Strand(pool), file_(file) {}
+};
+
 // 文件集合进行监听
 class FilesListener
 {
 protected:
+    // 按fd下标的处理表项，只保存裸指针，所有权在files_与strands_中
+    struct FileEntry
+    {
+        FileDescriptor *file = NULL;
+        Strand *strand = NULL;
+        bool drain = false;   // 就绪时一直读到EAGAIN（边缘触发）
+        bool pending = false; // 预算用完还有数据，已放入pending_等待下一轮
+        uint32_t gen = 0;     // 每次删除fd加一，fd被新文件重用后可以区分迟到的回调
+    };
+
     // fd to FileDescriptor
     std::map<int, std::shared_ptr<FileDescriptor>> files_;
+    // 以fd为下标的处理表，事件循环中查找不需要遍历map，也不会复制共享指针
+    std::vector<FileEntry> table_;
     // 使用线程池处理内容
     bool use_thread_pool_;
     ThreadPool *pool_ = NULL;
+    bool owns_pool_ = false;
+    // 使用线程池时每个文件一个Strand，同一个文件的回调按顺序执行且不会并发
+    std::map<int, std::shared_ptr<FileStrand>> strands_;
+    // 一轮就绪事件中要送入线程池的任务，整批提交
+    std::vector<Task> batch_;
+    // 文件在回调排队或执行期间不再被监听，回调结束后由工作线程调用rearm()重新启用
+    bool rearm_after_callback_ = false;
+    // 大于0时，支持的文件就绪后一次最多处理drain_budget_条消息，直到读完（边缘触发用）
+    // 预算用完的文件放到下一轮继续处理，避免一个繁忙的管道让其他管道饿死
+    int drain_budget_ = 0;
+    // 同步处理时预算用完、还需要继续读的fd，两个数组交替使用，不需要分配内存
+    std::vector<int> pending_;
+    std::vector<int> pending_round_;
+    // 其他线程通过post()送入事件循环的任务，写wakeup_fd_唤醒循环，在两轮就绪事件之间整批执行
+    int wakeup_fd_ = -1;
+    std::mutex posted_mutex_;
+    std::vector<Task> posted_;
+    std::vector<Task> posted_round_;
+    // 定时器，timerfd与文件一起被监听，到期的定时器在两轮就绪事件之间执行
+    std::unique_ptr<TimerWheel> timers_;
 
-public:
-    FilesListener(bool use_thread_pool)
+    // 重新启用文件的监听，由一次性触发的监听器实现（比如EPOLLONESHOT）
+    // 在工作线程中调用，entry为分发时表项的副本，不能读取table_（事件循环可能同时修改）
+    virtual void rearm(int fd, const FileEntry &entry) {}
+
+    // 在工作线程中读取文件直到EAGAIN，预算用完则排到Strand队尾继续，读完后再重新启用
+    void drain_task(FileDescriptor *file, Strand *strand, int fd, FileEntry entry)
+    {
+        if (!file->drain_callback(drain_budget_))
+        {
+            strand->post(Task([this, file, strand, fd, entry]()
+                              { drain_task(file, strand, fd, entry); }));
+            return;
+        }
+        if (rearm_after_callback_)
+            rearm(fd, entry);
+    }
+
+    // 处理就绪的fd：使用线程池时放入该文件的Strand，需要调度的Strand放入本轮的批量任务中
+    // 不使用线程池则同步处理
+    void dispatch(int fd)
+    {
+        if (fd < 0 || fd >= table_.size() || table_[fd].file == NULL)
+        {
+            Log::warn("fd " + std::to_string(fd) + " is ready but not registered");
+            return;
+        }
+
+        FileEntry &entry = table_[fd];
+        FileDescriptor *file = entry.file;
+        if (!use_thread_pool_)
+        {
+            if (!entry.drain)
+                file->recv_callback();
+            else if (!file->drain_callback(drain_budget_) && !entry.pending)
+            {
+                // 边缘触发不会再通知，记下来下一轮继续读
+                entry.pending = true;
+                pending_.push_back(fd);
+            }
+            return;
+        }
+
+        Task task;
+        Strand *strand = entry.strand;
+        FileEntry copy = entry;
+        if (entry.drain)
+            task = Task([this, file, strand, fd, copy]()
+                        { drain_task(file, strand, fd, copy); });
+        else if (rearm_after_callback_)
+            task = Task([this, file, fd, copy]()
+                        {
+                            file->recv_callback();
+                            rearm(fd, copy);
+                        });
+        else
+            task = Task([file]()
+                        { file->recv_callback(); });
+
+        post_to_strand(strand, task);
+    }
+
+    // 任务放入文件的Strand
+    void post_to_strand(Strand *strand, Task &task)
+    {
+        // Strand从空闲变为忙碌时才需要调度，只有这时才增加一次引用计数
+        if (strand->enqueue(task))
+        {
+            std::shared_ptr<Strand> self = strand->shared_from_this();
+            batch_.emplace_back([self]()
+                                { self->run(); });
+        }
+    }
+
+    // 继续处理上一轮预算用完的fd，已被删除的跳过
+    void dispatch_pending()
+    {
+        pending_round_.swap(pending_);
+        for (int fd : pending_round_)
+        {
+            if (fd >= table_.size() || !table_[fd].pending)
+                continue;
+            table_[fd].pending = false;
+            dispatch(fd);
+        }
+        pending_round_.clear();
+    }
+
+    // 一轮就绪事件处理完后，将本轮的任务一次性送入线程池
+    // 线程池的队列满时不再读取新的事件，等待工作线程腾出空间，背压传给管道的写端
+    // 调用时不能持有工作线程可能需要的锁
+    void flush_dispatch()
+    {
+        if (!use_thread_pool_ || batch_.empty())
+            return;
+        pool_->try_post_batch(batch_);
+        if (batch_.empty())
+            return;
+
+        Log::warn("thread pool is full, event loop waits for workers");
+        do
+        {
+            std::this_thread::yield();
+            pool_->try_post_batch(batch_);
+        } while (!batch_.empty());
+    }
+
+    // 读走唤醒的计数，唤醒fd就绪时调用
+    void consume_wakeup()
+    {
+        uint64_t count;
+        if (read(wakeup_fd_, &count, sizeof(count)) == -1 && errno != EAGAIN)
+            Log::warn("read wakeup fd failed: " + std::string(strerror(errno)));
+    }
+
+    // 在事件循环中执行其他线程送入的任务
+    void run_posted()
+    {
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            if (posted_.empty())
+                return;
+            posted_round_.swap(posted_);
+        }
+        for (Task &task : posted_round_)
+            task();
+        posted_round_.clear();
+    }
+
+    // 由多个事件循环组成、自己不运行循环的监听器用（比如FilesListenerMulti）：
+    // has_loop为false时不创建唤醒用的eventfd与定时器，post()与timers()需要由子类转发给其中的循环
+    FilesListener(bool use_thread_pool, ThreadPool *pool, bool has_loop)
         : use_thread_pool_(use_thread_pool)
     {
-        if (use_thread_pool_)
+        if (use_thread_pool_ && pool != NULL)
+            pool_ = pool;
+        else if (use_thread_pool_)
         {
             int thread_num = atoi(config::get("thread_num").c_str());
-            pool_ = new ThreadPool(thread_num);
+            pool_ = new ThreadPool(thread_num, ThreadPool::mode_from_config(), ThreadPool::queue_capacity_from_config(), ThreadPool::spin_us_from_config());
+            owns_pool_ = true;
         }
+
+        if (!has_loop)
+            return;
+
+        timers_.reset(new TimerWheel(atoi(config::get("timer_tick_ms", "10").c_str())));
+        timers_->set_pool(pool_);
+
+        wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wakeup_fd_ == -1)
+            UtilError::error_exit("eventfd create error", true);
     }
 
-    ~FilesListener()
+public:
+    // 使用线程池时可以传入共享的线程池（比如多个事件循环共用一个），否则自己创建
+    FilesListener(bool use_thread_pool, ThreadPool *pool = NULL)
+        : FilesListener(use_thread_pool, pool, true) {}
+
+    virtual ~FilesListener()
     {
-        if (use_thread_pool_)
+        if (wakeup_fd_ != -1)
+            close(wakeup_fd_);
+        if (owns_pool_)
             delete pool_;
     }
 
+    // 事件循环的定时器，只能在事件循环的线程中使用（监听开始前也可以）
+    // 比如 listener.timers().schedule(1000, fn) 一秒后在事件循环中执行fn
+    virtual TimerWheel &timers() { return *timers_; }
+
+    // 把任务送入事件循环的线程执行，可以在任意线程调用
+    // 比如在线程池中完成耗时的处理后，回到事件循环中回复，不需要加锁
+    virtual void post(Task task)
+    {
+        bool wakeup;
+        {
+            std::lock_guard<std::mutex> lock(posted_mutex_);
+            wakeup = posted_.empty();
+            posted_.emplace_back(std::move(task));
+        }
+
+        // 队列原来为空时才需要唤醒，已有任务时循环一定会被唤醒
+        uint64_t one = 1;
+        if (wakeup && write(wakeup_fd_, &one, sizeof(one)) == -1 && errno != EAGAIN)
+            Log::warn("write wakeup fd failed: " + std::string(strerror(errno)));
+    }
+
+    // 等待fd可写一次，就绪时在事件循环中执行callback，返回是否开始等待（写队列用）
+    // 默认实现不监听可写事件，而是在下一个定时器tick重试，由callback自己判断是否可写、是否继续等待
+    // fd不能同时通过add_fd()监听，可以在任意线程调用
+    virtual bool wait_writable(int fd, Task callback)
+    {
+        std::shared_ptr<Task> cb = std::make_shared<Task>(std::move(callback));
+        post(Task([this, cb]()
+                  { timers().schedule(1, [cb]()
+                                      { (*cb)(); }); }));
+        return true;
+    }
+
+    // 取消fd的等待（比如关闭fd之前），没有等待时不操作
+    virtual void cancel_wait(int fd) {}
+
     // 添加要监听的文件描述符
-    bool add_fd(std::shared_ptr<FileDescriptor> file)
+    virtual bool add_fd(std::shared_ptr<FileDescriptor> file)
     {
         // 未打开则打开
         file->openfile();
@@ -51,11 +287,22 @@ public:
         }
 
         files_[fd] = file;
+        if (fd >= table_.size())
+            table_.resize(fd + 1);
+        table_[fd].file = file.get();
+        table_[fd].drain = drain_budget_ > 0 && file->can_drain();
+
+        if (use_thread_pool_)
+        {
+            auto strand = std::make_shared<FileStrand>(pool_, file);
+            strands_[fd] = strand;
+            table_[fd].strand = strand.get();
+        }
         return true;
     }
 
     // 删除要监听的文件描述符
-    bool remove_fd(std::shared_ptr<FileDescriptor> file)
+    virtual bool remove_fd(std::shared_ptr<FileDescriptor> file)
     {
         int fd = file->get_fd();
 
@@ -67,8 +314,13 @@ public:
             return false;
         }
 
-        // 删除
+        // 删除，已经在Strand中排队的回调仍会执行完，Strand持有文件直到回调结束
+        // 同步处理时在回调中删除自身，调用者需要另外持有文件的共享指针
         files_.erase(it);
+        strands_.erase(fd);
+        uint32_t gen = table_[fd].gen;
+        table_[fd] = FileEntry();
+        table_[fd].gen = gen + 1;
         return true;
     }
 
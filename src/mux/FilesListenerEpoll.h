@@ -1,6 +1,9 @@
 #ifndef __FILE_LISTENER_EPOLL_H__
 #define __FILE_LISTENER_EPOLL_H__
 
+#include <map>
+#include <mutex>
+#include <chrono>
 #include <vector>
 #include <sys/epoll.h>
 
@@ -12,31 +15,183 @@ class FilesListenerEpoll : public FilesListener
 private:
     // epoll用
     int epoll_fd_;
+    // 预先分配的就绪事件数组，大小由配置项epoll_max_events决定
+    std::vector<struct epoll_event> events_;
+    // 忙等模式：阻塞等待前先以零超时反复epoll_wait，busy_poll_us_为自旋时间的上限，0表示不忙等
+    // 自旋期间等到事件则下次的自旋时间加倍，没等到则减半，负载低时自动减少空转
+    int busy_poll_us_ = 0;
+    int spin_window_us_ = 0;
+    // 保护fd表，其他线程可以在监听时添加、删除fd，同一线程的回调中也可以
+    std::recursive_mutex loop_mutex_;
+    // 一次性触发模式（EPOLLONESHOT）：回调排队或执行期间fd不会再次触发，回调结束后重新启用
+    bool oneshot_;
+    // 不通过add_fd()监听、只等待一次就绪的fd与就绪时执行的回调（协程用）
+    std::map<int, Task> waiting_;
+    // 本轮就绪的一次性等待的fd与回调，释放loop_mutex_之后执行（回调可能获取文件的锁，持有文件锁的线程可能正在等待loop_mutex_）
+    std::vector<std::pair<int, Task>> waits_ready_;
+
+    // 注册时的事件，支持一直读到EAGAIN的文件在边缘触发模式下使用EPOLLET
+    uint32_t read_events(bool drain)
+    {
+        uint32_t events = oneshot_ ? (EPOLLIN | EPOLLONESHOT) : EPOLLIN;
+        if (drain)
+            events |= EPOLLET;
+        return events;
+    }
+
+    // 等待事件，忙等模式下先自旋
+    int wait(int timeout)
+    {
+        if (timeout == 0 || busy_poll_us_ <= 0)
+            return epoll_wait(epoll_fd_, events_.data(), events_.size(), timeout);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(spin_window_us_);
+        do
+        {
+            int nfds = epoll_wait(epoll_fd_, events_.data(), events_.size(), 0);
+            if (nfds != 0)
+            {
+                if (nfds > 0)
+                    spin_window_us_ = std::min(busy_poll_us_, spin_window_us_ * 2);
+                return nfds;
+            }
+            UtilSystem::cpu_relax();
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        // 这次没有等到，缩短下次的自旋时间后阻塞等待
+        spin_window_us_ = std::max(1, spin_window_us_ / 2);
+        return epoll_wait(epoll_fd_, events_.data(), events_.size(), timeout);
+    }
+
+    // 工作线程处理完后重新启用fd，事件由分发时的表项决定
+    // fd已被删除，或者已被新文件重用（gen不同）时忽略，不能用旧文件的设置修改新文件的监听
+    void rearm(int fd, const FileEntry &entry)
+    {
+        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+        if (fd >= table_.size() || table_[fd].file == NULL || table_[fd].gen != entry.gen)
+            return;
+
+        struct epoll_event ev;
+        ev.events = read_events(entry.drain);
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == -1 && errno != ENOENT && errno != EBADF)
+            Log::warn("epoll rearm fd " + std::to_string(fd) + " failed: " + std::string(strerror(errno)));
+    }
+
+    // 一次性等待fd就绪
+    bool wait_event(int fd, uint32_t events, Task callback)
+    {
+        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+        bool waiting = waiting_.find(fd) != waiting_.end();
+
+        struct epoll_event ev;
+        ev.events = events | EPOLLONESHOT;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, waiting ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) == -1)
+        {
+            Log::warn("epoll wait fd " + std::to_string(fd) + " failed: " + std::string(strerror(errno)));
+            return false;
+        }
+        waiting_[fd] = std::move(callback);
+        return true;
+    }
+
+    // fd就绪时取消监听，等待的回调放入waits_ready_，回调中可以再次等待，不是等待中的fd返回false
+    bool take_waiting(int fd)
+    {
+        auto it = waiting_.find(fd);
+        if (it == waiting_.end())
+            return false;
+        Task callback = std::move(it->second);
+        waiting_.erase(it);
+
+        struct epoll_event ev;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &ev);
+        waits_ready_.emplace_back(fd, std::move(callback));
+        return true;
+    }
 
 public:
-    FilesListenerEpoll(bool use_thread_pool)
-        : FilesListener(use_thread_pool)
+    FilesListenerEpoll(bool use_thread_pool, ThreadPool *pool = NULL)
+        : FilesListener(use_thread_pool, pool)
     {
         epoll_fd_ = epoll_create(256);
         if (epoll_fd_ == -1)
             UtilError::error_exit("epoll create error", true);
+
+        int max_events = atoi(config::get("epoll_max_events", "64").c_str());
+        if (max_events <= 0)
+            UtilError::error_exit("error epoll_max_events setting", false);
+        events_.resize(max_events);
+
+        // 只有使用线程池时才需要一次性触发，同步处理时回调返回前不会再次epoll_wait
+        // 使用线程池时默认开启，否则水平触发下回调还没读走数据，fd会再次就绪，产生重复的回调
+        oneshot_ = use_thread_pool && config::get("epoll_oneshot", "true") == "true";
+        rearm_after_callback_ = oneshot_;
+
+        // 其他线程post()时唤醒循环
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeup_fd_;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev) == -1)
+            UtilError::error_exit("epoll add wakeup fd error", true);
+
+        // 定时器到期时唤醒循环
+        ev.data.fd = timers_->get_fd();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timers_->get_fd(), &ev) == -1)
+            UtilError::error_exit("epoll add timerfd error", true);
+
+        // 忙等模式
+        set_busy_poll_us(atoi(config::get("busy_poll_us", "0").c_str()));
+
+        // 边缘触发模式：每次就绪把管道里的消息读完，每个fd一次最多处理epoll_drain_budget条
+        if (config::get("epoll_edge_triggered", "false") == "true")
+        {
+            drain_budget_ = atoi(config::get("epoll_drain_budget", "64").c_str());
+            if (drain_budget_ <= 0)
+                UtilError::error_exit("error epoll_drain_budget setting", false);
+        }
+    }
+
+    ~FilesListenerEpoll() { close(epoll_fd_); }
+
+    // 设置忙等模式的自旋时间（微秒），0表示关闭，需要在listen()之前设置
+    void set_busy_poll_us(int us)
+    {
+        if (us < 0)
+            UtilError::error_exit("error busy_poll_us setting", false);
+        busy_poll_us_ = spin_window_us_ = us;
     }
 
-    ~FilesListenerEpoll()
+    // 等待fd可读或可写一次，就绪时在事件循环中执行callback，返回是否开始等待（协程用）
+    // fd不能同时通过add_fd()监听，每个fd同时只能有一个等待，再次调用会替换原来的回调
+    bool wait_readable(int fd, Task callback) { return wait_event(fd, EPOLLIN, std::move(callback)); }
+    bool wait_writable(int fd, Task callback) { return wait_event(fd, EPOLLOUT, std::move(callback)); }
+
+    // 取消fd的等待，关闭fd之前调用，否则fd号被重用时会执行过期的回调
+    // 已经就绪、还没开始执行的回调也不再执行；已经开始执行的回调不等待其结束
+    void cancel_wait(int fd)
     {
-        if (use_thread_pool_)
-            delete pool_;
+        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+        for (auto &ready : waits_ready_)
+            if (ready.first == fd)
+                ready.second = Task();
+        if (waiting_.erase(fd) == 0)
+            return;
+        struct epoll_event ev;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &ev);
     }
 
     // 添加要监听的管道
     bool add_fd(std::shared_ptr<FileDescriptor> file)
     {
+        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
         if (FilesListener::add_fd(file))
         {
             int fd = file->get_fd();
             // 增加管道到epoll
             struct epoll_event ev;
-            ev.events = EPOLLIN;
+            ev.events = read_events(table_[fd].drain);
             ev.data.fd = fd;
             epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
             return true;
@@ -47,6 +202,7 @@ public:
     // 删除要监听的管道
     bool remove_fd(std::shared_ptr<FileDescriptor> file)
     {
+        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
         if (FilesListener::remove_fd(file))
         {
             int fd = file->get_fd();
@@ -63,40 +219,92 @@ public:
     {
         while (true)
         {
-            // 获取最大的fd
-            int max_fd = files_.rbegin()->first;
-
-            // 等待任意管道来消息
+            // 等待任意管道来消息，有预算用完的fd时不阻塞
             int nfds;
-            struct epoll_event *events = new epoll_event[max_fd + 1];
-            if ((nfds = epoll_wait(epoll_fd_, events, max_fd + 1, -1)) != -1)
+            int timeout = pending_.empty() ? -1 : 0;
+            if ((nfds = wait(timeout)) != -1)
             {
-                // 遍历查询哪个管道就绪
-                bool has_fd = false;
-                for (int i = 0; i < nfds; i++)
+                // 处理本轮事件时不允许其他线程修改fd表，等待期间与送入线程池时不持有锁
+                // （线程池队列满时flush_dispatch()等待工作线程腾出空间，工作线程可能正在add_fd()/remove_fd()）
+                bool has_fd = timeout == 0;
+                bool woken = false;
+                bool timer_due = false;
+                {
+                    std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+                    // 上一轮预算用完的fd继续处理
+                    dispatch_pending();
+
+                    // 遍历查询哪个管道就绪
+                    for (int i = 0; i < nfds; i++)
+                    {
+                        // 只等待一次就绪的fd
+                        if (!waiting_.empty() && take_waiting(events_[i].data.fd))
+                        {
+                            has_fd = true;
+                            continue;
+                        }
+
+                        if (events_[i].events & EPOLLIN)
+                        {
+                            has_fd = true;
+                            int fd = events_[i].data.fd;
+                            if (fd == wakeup_fd_)
+                            {
+                                woken = true;
+                                continue;
+                            }
+                            if (fd == timers_->get_fd())
+                            {
+                                timer_due = true;
+                                continue;
+                            }
+
+                            // 使用线程池处理，或者同步阻塞处理
+                            dispatch(fd);
+                        }
+                    }
+                }
+
+                // 本轮的任务整批送入线程池
+                flush_dispatch();
+
+                // 执行就绪的一次性等待的回调，执行之前被cancel_wait()取消的跳过
+                for (size_t i = 0; i < waits_ready_.size(); i++)
                 {
-                    if (events[i].events & EPOLLIN)
+                    Task callback;
                     {
-                        int fd = events[i].data.fd;
-                        auto file = files_[fd];
-
-                        // 使用线程池处理
-                        if (use_thread_pool_)
-                            pool_->submit([&file]()
-                                          { file->recv_callback(); });
-                        // 同步阻塞处理
-                        else
-                            file->recv_callback();
-
-                        has_fd = true;
+                        std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+                        callback = std::move(waits_ready_[i].second);
                     }
+                    if (callback)
+                        callback();
+                }
+                {
+                    std::lock_guard<std::recursive_mutex> lock(loop_mutex_);
+                    waits_ready_.clear();
+                }
+
+                // 执行其他线程送入的任务
+                if (woken)
+                {
+                    consume_wakeup();
+                    run_posted();
                 }
+
+                // 执行到期的定时器
+                if (timer_due)
+                    timers_->expire();
+
                 if (has_fd)
                     continue;
 
                 UtilError::error_exit("epoll, but no fd is ready", false);
             }
 
+            // 被信号打断
+            if (errno == EINTR)
+                continue;
+
 #ifdef DEBUG
             // epoll失败
             UtilError::error_exit("epoll failed", true);
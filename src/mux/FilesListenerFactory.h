@@ -0,0 +1,34 @@
+#ifndef __FILE_LISTENER_FACTORY_H__
+#define __FILE_LISTENER_FACTORY_H__
+
+#include <memory>
+
+#include "src/mux/FilesListenerSelect.h"
+#include "src/mux/FilesListenerEpoll.h"
+#include "src/mux/FilesListenerUring.h"
+#include "src/mux/FilesListenerMulti.h"
+
+// 按配置项listener_backend（select、epoll、uring、reactors，默认epoll）创建监听器
+// 内核不支持io_uring时回退到epoll
+inline std::unique_ptr<FilesListener> make_files_listener(bool use_thread_pool)
+{
+    std::string backend = config::get("listener_backend", "epoll");
+    if (backend == "select")
+        return std::unique_ptr<FilesListener>(new FilesListenerSelect(use_thread_pool));
+
+    if (backend == "reactors")
+        return std::unique_ptr<FilesListener>(new FilesListenerMulti(use_thread_pool));
+
+    if (backend == "uring")
+    {
+        if (FilesListenerUring::supported())
+            return std::unique_ptr<FilesListener>(new FilesListenerUring(use_thread_pool));
+        Log::warn("io_uring is not supported by the kernel, fall back to epoll");
+    }
+    else if (backend != "epoll")
+        UtilError::error_exit("error listener_backend setting", false);
+
+    return std::unique_ptr<FilesListener>(new FilesListenerEpoll(use_thread_pool));
+}
+
+#endif
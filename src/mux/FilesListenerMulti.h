@@ -0,0 +1,218 @@
+#ifndef __FILE_LISTENER_MULTI_H__
+#define __FILE_LISTENER_MULTI_H__
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <functional>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "src/mux/FilesListenerEpoll.h"
+#include "src/fd/FileWithPath.h"
+
+// 多个事件循环（reactor）监听文件集合，每个循环一个线程、一个epoll实例
+// 文件按分配策略交给其中一个循环，之后由该循环负责等待、读取与分发
+// 使用线程池时所有循环共用一个线程池
+// 监听开始后也可以在其他线程中添加、删除文件
+// 自己不运行循环：post()、定时器与等待可写转发给其中的循环，不创建自己的eventfd与timerfd
+class FilesListenerMulti : public FilesListener
+{
+public:
+    // 分配策略：返回文件交给哪个循环，参数为文件与循环数
+    using Policy = std::function<int(const std::shared_ptr<FileDescriptor> &, int)>;
+
+    // 轮流分配
+    static Policy round_robin()
+    {
+        std::shared_ptr<int> next = std::make_shared<int>(0);
+        return [next](const std::shared_ptr<FileDescriptor> &file, int loop_num)
+        { return (*next)++ % loop_num; };
+    }
+
+    // 按路径的哈希分配，同一路径总是分到同一个循环；没有路径的文件按fd
+    static Policy path_hash()
+    {
+        return [](const std::shared_ptr<FileDescriptor> &file, int loop_num)
+        {
+            FileWithPath *f = dynamic_cast<FileWithPath *>(file.get());
+            if (f == NULL)
+                return file->get_fd() % loop_num;
+            return (int)(std::hash<std::string>()(f->get_path()) % loop_num);
+        };
+    }
+
+    // 按配置项reactor_policy（round_robin、path_hash，默认round_robin）选择策略
+    static Policy policy_from_config()
+    {
+        std::string policy = config::get("reactor_policy", "round_robin");
+        if (policy == "round_robin")
+            return round_robin();
+        if (policy == "path_hash")
+            return path_hash();
+        UtilError::error_exit("error reactor_policy setting", false);
+        return round_robin();
+    }
+
+private:
+    std::vector<std::unique_ptr<FilesListenerEpoll>> loops_;
+    // 每个循环绑定的CPU，-1表示不绑定
+    std::vector<int> cpus_;
+    Policy policy_;
+
+    // fd to 循环下标
+    std::map<int, int> owner_;
+    std::mutex owner_mutex_;
+
+    // 读取配置项reactor_cpus，比如"0,2,4"，第i个循环绑定到第i个CPU
+    void cpus_from_config()
+    {
+        std::stringstream ss(config::get("reactor_cpus", ""));
+        std::string cpu;
+        for (int i = 0; i < loops_.size() && std::getline(ss, cpu, ','); i++)
+            cpus_[i] = atoi(cpu.c_str());
+    }
+
+    // 当前线程绑定到cpu
+    static void bind_cpu(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0)
+            Log::warn("bind reactor to cpu " + std::to_string(cpu) + " failed: " + std::string(strerror(err)));
+    }
+
+public:
+    // loop_num为0时使用配置项reactor_num，默认为CPU核数
+    FilesListenerMulti(bool use_thread_pool, int loop_num = 0, Policy policy = Policy())
+        : FilesListener(use_thread_pool, NULL, false),
+          policy_(policy ? policy : policy_from_config())
+    {
+        if (loop_num <= 0)
+            loop_num = atoi(config::get("reactor_num", std::to_string(std::thread::hardware_concurrency())).c_str());
+        if (loop_num <= 0)
+            UtilError::error_exit("error reactor_num setting", false);
+
+        for (int i = 0; i < loop_num; i++)
+            loops_.emplace_back(new FilesListenerEpoll(use_thread_pool, pool_));
+        cpus_.assign(loop_num, -1);
+        cpus_from_config();
+    }
+
+    int loop_num() { return loops_.size(); }
+
+    // 第i个循环绑定到cpu，需要在listen()之前设置，循环不存在时返回false
+    bool set_cpu(int i, int cpu)
+    {
+        if (i < 0 || i >= loops_.size())
+        {
+            Log::warn("reactor " + std::to_string(i) + " not exits");
+            return false;
+        }
+        cpus_[i] = cpu;
+        return true;
+    }
+
+    // 按分配策略添加文件
+    bool add_fd(std::shared_ptr<FileDescriptor> file)
+    {
+        int i;
+        {
+            std::lock_guard<std::mutex> lock(owner_mutex_);
+            i = policy_(file, loops_.size());
+        }
+        return add_fd(file, i);
+    }
+
+    // 把文件交给第i个循环
+    bool add_fd(std::shared_ptr<FileDescriptor> file, int i)
+    {
+        if (i < 0 || i >= loops_.size())
+        {
+            Log::warn("reactor " + std::to_string(i) + " not exits");
+            return false;
+        }
+
+        file->openfile();
+        int fd = file->get_fd();
+        {
+            std::lock_guard<std::mutex> lock(owner_mutex_);
+            if (owner_.find(fd) != owner_.end())
+            {
+                Log::warn("file with fd " + std::to_string(fd) + " has already been added to selector");
+                return false;
+            }
+            owner_[fd] = i;
+        }
+
+        if (loops_[i]->add_fd(file))
+            return true;
+
+        std::lock_guard<std::mutex> lock(owner_mutex_);
+        owner_.erase(fd);
+        return false;
+    }
+
+    // 从所在的循环中删除文件
+    bool remove_fd(std::shared_ptr<FileDescriptor> file)
+    {
+        int fd = file->get_fd();
+        int i;
+        {
+            std::lock_guard<std::mutex> lock(owner_mutex_);
+            auto it = owner_.find(fd);
+            if (it == owner_.end())
+            {
+                Log::warn("file with fd " + std::to_string(fd) + " not exits in selector");
+                return false;
+            }
+            i = it->second;
+            owner_.erase(it);
+        }
+        return loops_[i]->remove_fd(file);
+    }
+
+    // 把任务送入第i个循环的线程执行
+    void post(int i, Task task) { loops_[i]->post(std::move(task)); }
+
+    // 不指定循环时送入第一个循环
+    void post(Task task) { post(0, std::move(task)); }
+
+    // 第i个循环的定时器，只能在该循环的线程中使用（监听开始前也可以）
+    TimerWheel &timers(int i) { return loops_[i]->timers(); }
+
+    // 不指定循环时使用第一个循环的定时器
+    TimerWheel &timers() { return timers(0); }
+
+    // 不属于任何循环的fd在第一个循环中等待可写
+    bool wait_writable(int fd, Task callback) { return loops_[0]->wait_writable(fd, std::move(callback)); }
+    void cancel_wait(int fd) { loops_[0]->cancel_wait(fd); }
+
+    // 每个循环在自己的线程中监听，不会返回
+    void listen()
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < loops_.size(); i++)
+        {
+            FilesListenerEpoll *loop = loops_[i].get();
+            int cpu = cpus_[i];
+            threads.emplace_back([loop, cpu]()
+                                 {
+                                     if (cpu >= 0)
+                                         bind_cpu(cpu);
+                                     loop->listen();
+                                 });
+        }
+
+        for (auto &t : threads)
+            t.join();
+    }
+};
+
+#endif
@@ -1,25 +1,87 @@
 #ifndef __FILE_LISTENER_SELECT_H__
 #define __FILE_LISTENER_SELECT_H__
 
+#include <vector>
+
+#include <poll.h>
 #include <sys/select.h>
 
 #include "src/mux/FilesListener.h"
 
 // 文件集合进行监听
+// 所有fd都小于FD_SETSIZE时使用select，否则自动改用poll
+// 监听的fd保存在紧凑的数组中，每轮只遍历这个数组，并处理所有就绪的fd
 class FilesListenerSelect : public FilesListener
 {
 private:
     // select用
     fd_set read_fd_set_;
+    int max_fd_;
+    // poll用，前两项为post()的唤醒与定时器，之后是文件，删除时与最后一项交换
+    std::vector<struct pollfd> pollfds_;
+    // 以fd为下标，文件在pollfds_中的位置
+    std::vector<int> pos_;
+    // 不小于FD_SETSIZE的fd数，大于0时使用poll
+    int big_fds_ = 0;
+    // 本轮就绪的文件，先收集再处理，回调中删除文件不会影响遍历
+    std::vector<int> ready_;
+
+    static const int INTERNAL_FDS = 2;
+
+    void watch(int fd)
+    {
+        struct pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        pollfds_.push_back(p);
+
+        if (fd < FD_SETSIZE)
+            FD_SET(fd, &read_fd_set_);
+        else
+            big_fds_++;
+        max_fd_ = std::max(max_fd_, fd);
+    }
+
+    // 等待并收集就绪的文件，返回是否被post()唤醒、是否有定时器到期
+    bool wait(bool &woken, bool &timer_due)
+    {
+        ready_.clear();
+        if (big_fds_ > 0)
+        {
+            if (poll(pollfds_.data(), pollfds_.size(), -1) == -1)
+                return false;
+
+            woken = pollfds_[0].revents != 0;
+            timer_due = pollfds_[1].revents != 0;
+            for (int i = INTERNAL_FDS; i < pollfds_.size(); i++)
+                if (pollfds_[i].revents & (POLLIN | POLLHUP | POLLERR))
+                    ready_.push_back(pollfds_[i].fd);
+            return true;
+        }
+
+        fd_set tmp = read_fd_set_;
+        if (select(max_fd_ + 1, &tmp, NULL, NULL, NULL) == -1)
+            return false;
+
+        woken = FD_ISSET(wakeup_fd_, &tmp);
+        timer_due = FD_ISSET(timers_->get_fd(), &tmp);
+        for (int i = INTERNAL_FDS; i < pollfds_.size(); i++)
+            if (FD_ISSET(pollfds_[i].fd, &tmp))
+                ready_.push_back(pollfds_[i].fd);
+        return true;
+    }
 
 public:
     FilesListenerSelect(bool use_thread_pool)
-        : FilesListener(use_thread_pool) { FD_ZERO(&read_fd_set_); }
-
-    ~FilesListenerSelect()
+        : FilesListener(use_thread_pool)
     {
-        if (use_thread_pool_)
-            delete pool_;
+        FD_ZERO(&read_fd_set_);
+        max_fd_ = -1;
+        // 其他线程post()时唤醒循环
+        watch(wakeup_fd_);
+        // 定时器到期时唤醒循环
+        watch(timers_->get_fd());
     }
 
     // 添加要监听的管道
@@ -28,7 +90,10 @@ public:
         if (FilesListener::add_fd(file))
         {
             int fd = file->get_fd();
-            FD_SET(fd, &read_fd_set_);
+            if (fd >= pos_.size())
+                pos_.resize(fd + 1, -1);
+            pos_[fd] = pollfds_.size();
+            watch(fd);
             return true;
         }
         return false;
@@ -40,7 +105,26 @@ public:
         if (FilesListener::remove_fd(file))
         {
             int fd = file->get_fd();
-            FD_CLR(fd, &read_fd_set_);
+
+            // 与最后一项交换后删除
+            int i = pos_[fd];
+            pollfds_[i] = pollfds_.back();
+            pos_[pollfds_[i].fd] = i;
+            pollfds_.pop_back();
+            pos_[fd] = -1;
+
+            if (fd < FD_SETSIZE)
+                FD_CLR(fd, &read_fd_set_);
+            else
+                big_fds_--;
+
+            // 删除的是最大的fd时重新计算
+            if (fd == max_fd_)
+            {
+                max_fd_ = -1;
+                for (auto &p : pollfds_)
+                    max_fd_ = std::max(max_fd_, p.fd);
+            }
             return true;
         }
         return false;
@@ -51,44 +135,38 @@ public:
     {
         while (true)
         {
-            // 获取最大的fd
-            int max_fd = files_.rbegin()->first;
-
             // 等待任意管道来消息
-            int res;
-            fd_set tmp = read_fd_set_;
-            if ((res = select(max_fd + 1, &tmp, NULL, NULL, NULL)) != -1)
+            bool woken = false, timer_due = false;
+            if (wait(woken, timer_due))
             {
-                // 遍历查询哪个管道就绪
-                bool has_fd = false;
-                for (auto &&p : files_)
+                // 处理所有就绪的管道，使用线程池处理，或者同步阻塞处理
+                for (int fd : ready_)
+                    dispatch(fd);
+
+                // 本轮的任务送入线程池
+                flush_dispatch();
+
+                // 执行其他线程送入的任务，监听期间添加、删除文件也需要通过post()在循环中进行
+                if (woken)
                 {
-                    int fd = p.first;
-
-                    // 调用预先定义的回调函数
-                    if (FD_ISSET(fd, &tmp))
-                    {
-                        auto file = p.second;
-
-                        // 使用线程池处理
-                        if (use_thread_pool_)
-                            pool_->submit([&file]()
-                                          { file->recv_callback(); });
-                        // 同步阻塞处理
-                        else
-                            file->recv_callback();
-
-                        has_fd = true;
-                        break;
-                    }
+                    consume_wakeup();
+                    run_posted();
                 }
 
-                if (has_fd)
+                // 执行到期的定时器
+                if (timer_due)
+                    timers_->expire();
+
+                if (!ready_.empty() || woken || timer_due)
                     continue;
 
                 UtilError::error_exit("select, but no fd is ready", false);
             }
 
+            // 被信号打断
+            if (errno == EINTR)
+                continue;
+
 #ifdef DEBUG
             // select失败
             UtilError::error_exit("select failed", true);
@@ -99,4 +177,4 @@ public:
     }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,637 @@
+#ifndef __FILE_LISTENER_URING_H__
+#define __FILE_LISTENER_URING_H__
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "src/mux/FilesListener.h"
+
+// 使用io_uring监听文件集合，直接使用系统调用，不依赖liburing
+// 固定长度消息的文件（record_size() > 0）：每个fd保持一组链接的请求 POLL_ADD -> READ_FIXED，
+// 数据就绪后内核直接把整条消息读入预先注册的缓冲区，处理后重新提交，所有提交与等待合并为一次io_uring_enter
+// 其他文件只提交POLL_ADD，就绪后照常调用recv_callback()
+// 回调期间不再监听该fd，处理完后重新提交，与EPOLLONESHOT相同
+class FilesListenerUring : public FilesListener
+{
+private:
+    // user_data低2位为请求类型，POLL与READ的其余位为fd与代数，WRITE为WriteReq指针
+    enum Op : uint64_t
+    {
+        OP_POLL = 0,
+        OP_READ = 1,
+        OP_WRITE = 2,
+        OP_CANCEL = 3
+    };
+
+    // fd的状态
+    enum State : int8_t
+    {
+        IDLE,  // 未提交请求
+        ARMED, // 请求已提交，等待完成
+        BUSY   // 请求已完成，回调排队或执行中
+    };
+
+    struct UringEntry
+    {
+        State state = IDLE;
+        uint32_t gen = 0;      // 每次删除fd加一，用于忽略已删除fd的迟到的完成事件
+        int slot = -1;         // 注册缓冲区中的槽位，-1表示只监听就绪
+        size_t record_len = 0; // 每条消息的长度
+        size_t got = 0;        // 当前消息已读入槽位的字节数，读不完整时下次从这里继续
+    };
+
+    // 通过ring写出的数据，完成前由ring持有
+    struct WriteReq
+    {
+        std::shared_ptr<FileDescriptor> file;
+        std::string data;
+    };
+
+    int ring_fd_ = -1;
+
+    // 提交队列
+    void *sq_ptr_ = MAP_FAILED;
+    size_t sq_map_size_ = 0;
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_mask_;
+    unsigned *sq_array_;
+    unsigned sq_entries_;
+    struct io_uring_sqe *sqes_ = (struct io_uring_sqe *)MAP_FAILED;
+    size_t sqes_map_size_ = 0;
+    unsigned sq_local_tail_ = 0; // 已填写但未发布的队尾
+    unsigned to_submit_ = 0;     // 已发布但未提交给内核的请求数
+
+    // 完成队列
+    void *cq_ptr_ = MAP_FAILED;
+    size_t cq_map_size_ = 0;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned *cq_mask_;
+    struct io_uring_cqe *cqes_;
+
+    // 注册缓冲区，按槽位分给固定长度消息的fd
+    char *buffers_ = NULL;
+    size_t slot_size_ = 0;
+    std::vector<int> free_slots_;
+    // 已删除但读请求还未完成的fd占用的槽位：fd -> (代数, 槽位)
+    std::vector<std::pair<int, std::pair<uint32_t, int>>> retired_slots_;
+
+    // 以fd为下标的状态
+    std::vector<UringEntry> uring_;
+
+    // 提交队列与fd状态的锁，使用线程池时工作线程也会提交请求
+    std::recursive_mutex sq_mutex_;
+    std::thread::id loop_thread_;
+
+    static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+    {
+        return (int)syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+    }
+
+    static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+    {
+        return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+    static uint64_t tag(int fd, uint32_t gen, Op op)
+    {
+        return ((uint64_t)gen << 34) | ((uint64_t)(uint32_t)fd << 2) | op;
+    }
+
+    // 映射提交队列与完成队列
+    void map_rings(struct io_uring_params &p)
+    {
+        sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+
+        sq_ptr_ = mmap(NULL, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED)
+            UtilError::error_exit("io_uring mmap sq ring failed", true);
+
+        if (single_mmap)
+            cq_ptr_ = sq_ptr_;
+        else
+        {
+            cq_ptr_ = mmap(NULL, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+                UtilError::error_exit("io_uring mmap cq ring failed", true);
+        }
+
+        sqes_map_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = (struct io_uring_sqe *)mmap(NULL, sqes_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED)
+            UtilError::error_exit("io_uring mmap sqes failed", true);
+
+        char *sq = (char *)sq_ptr_;
+        sq_head_ = (unsigned *)(sq + p.sq_off.head);
+        sq_tail_ = (unsigned *)(sq + p.sq_off.tail);
+        sq_mask_ = (unsigned *)(sq + p.sq_off.ring_mask);
+        sq_array_ = (unsigned *)(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+        sq_local_tail_ = *sq_tail_;
+
+        char *cq = (char *)cq_ptr_;
+        cq_head_ = (unsigned *)(cq + p.cq_off.head);
+        cq_tail_ = (unsigned *)(cq + p.cq_off.tail);
+        cq_mask_ = (unsigned *)(cq + p.cq_off.ring_mask);
+        cqes_ = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    }
+
+    // 分配并注册缓冲区，失败时所有文件只监听就绪
+    void register_buffers(int slot_num)
+    {
+        if (slot_num == 0)
+            return;
+
+        size_t total = slot_num * slot_size_;
+        if (posix_memalign((void **)&buffers_, 4096, total) != 0)
+            UtilError::error_exit("io_uring alloc buffers failed", false);
+
+        struct iovec iov;
+        iov.iov_base = buffers_;
+        iov.iov_len = total;
+        if (io_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, &iov, 1) != 0)
+        {
+            Log::warn("io_uring register buffers failed: " + std::string(strerror(errno)) + ", fall back to poll only");
+            free(buffers_);
+            buffers_ = NULL;
+            return;
+        }
+
+        for (int i = slot_num - 1; i >= 0; i--)
+            free_slots_.push_back(i);
+    }
+
+    // 把已填写的请求发布给内核
+    void publish() { __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE); }
+
+    // 取出要提交的请求数，需要持有锁
+    unsigned take_submit()
+    {
+        publish();
+        unsigned n = to_submit_;
+        to_submit_ = 0;
+        return n;
+    }
+
+    // 提交失败或没有全部提交时，剩下的留到下次
+    void submitted(unsigned n, int res)
+    {
+        if (res < 0)
+        {
+            if (errno != EINTR)
+                Log::warn("io_uring submit failed: " + std::string(strerror(errno)));
+            res = 0;
+        }
+        if (res < n)
+            to_submit_ += n - res;
+    }
+
+    // 立即提交，需要持有锁
+    void submit_now()
+    {
+        unsigned n = take_submit();
+        if (n > 0)
+            submitted(n, io_uring_enter(ring_fd_, n, 0, 0));
+    }
+
+    // 保证提交队列中至少有n个空位，需要持有锁
+    void reserve(unsigned n)
+    {
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) + n <= sq_entries_)
+            return;
+
+        submit_now();
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) + n > sq_entries_)
+            UtilError::error_exit("io_uring submission queue is full", false);
+    }
+
+    // 取一个空的提交项，调用前需要reserve()
+    struct io_uring_sqe *get_sqe()
+    {
+        unsigned idx = sq_local_tail_ & *sq_mask_;
+        struct io_uring_sqe *sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        sq_local_tail_++;
+        to_submit_++;
+        return sqe;
+    }
+
+    // 提交fd的请求，需要持有锁
+    void arm(int fd)
+    {
+        UringEntry &entry = uring_[fd];
+        reserve(2);
+
+        struct io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = tag(fd, entry.gen, OP_POLL);
+
+        // 就绪后直接读入注册缓冲区
+        if (entry.slot >= 0)
+        {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe = get_sqe();
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->fd = fd;
+            sqe->addr = (uint64_t)(buffers_ + entry.slot * slot_size_ + entry.got);
+            sqe->len = entry.record_len - entry.got;
+            sqe->off = (uint64_t)-1;
+            sqe->buf_index = 0;
+            sqe->user_data = tag(fd, entry.gen, OP_READ);
+        }
+        entry.state = ARMED;
+    }
+
+    // 读请求完成后处理消息，处理完再重新提交；fd在处理期间被删除时释放槽位
+    void finish_record(int fd, uint32_t gen, int slot)
+    {
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        if (fd < uring_.size() && uring_[fd].gen == gen && uring_[fd].state == BUSY)
+        {
+            arm(fd);
+            if (std::this_thread::get_id() != loop_thread_)
+                submit_now();
+        }
+        else
+            free_slots_.push_back(slot);
+    }
+
+    // 工作线程处理完只监听就绪的文件后重新提交
+    // fd表只在持有sq_mutex_时修改，代数不同说明fd已被删除（可能已被新文件重用），不能为新文件提交
+    void rearm(int fd, const FileEntry &entry)
+    {
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        if (fd < uring_.size() && table_[fd].gen == entry.gen && uring_[fd].state == BUSY)
+        {
+            arm(fd);
+            submit_now();
+        }
+    }
+
+    // 读请求完成
+    void on_read(int fd, uint32_t gen, int res)
+    {
+        UringEntry &entry = uring_[fd];
+        int slot = entry.slot;
+
+        // fd已被删除，请求已取消或数据作废，释放槽位
+        if (entry.gen != gen)
+        {
+            for (auto &&p : retired_slots_)
+                if (p.first == fd && p.second.first == gen)
+                {
+                    free_slots_.push_back(p.second.second);
+                    p = retired_slots_.back();
+                    retired_slots_.pop_back();
+                    break;
+                }
+            return;
+        }
+
+        // 链接的就绪请求失败
+        if (entry.state != ARMED)
+            return;
+
+        // 只读到消息的一部分（比如写端分多次写入），保留已读的字节，下次读入剩下的部分
+        if (res > 0 && entry.got + res < entry.record_len)
+        {
+            entry.got += res;
+            arm(fd);
+            return;
+        }
+
+        // 没有数据：暂时没有数据则重新提交，EOF交给文件处理
+        if (res <= 0)
+        {
+            if (res == 0)
+            {
+                if (entry.got > 0)
+                    Log::warn("fd " + std::to_string(fd) + " closed in the middle of a record, drop " + std::to_string(entry.got) + " bytes");
+                entry.got = 0;
+                table_[fd].file->eof_callback(0);
+            }
+            else if (res != -EAGAIN && res != -ECANCELED && res != -EINTR)
+            {
+                Log::warn("io_uring read fd " + std::to_string(fd) + " failed: " + std::string(strerror(-res)));
+                entry.state = IDLE;
+                return;
+            }
+            arm(fd);
+            return;
+        }
+
+        entry.got = 0;
+        entry.state = BUSY;
+        FileDescriptor *file = table_[fd].file;
+        const char *buf = buffers_ + slot * slot_size_;
+        size_t len = entry.record_len;
+        if (!use_thread_pool_)
+        {
+            file->recv_record_callback(buf, len);
+            finish_record(fd, gen, slot);
+            return;
+        }
+
+        // Strand持有文件，fd在回调排队期间被删除时槽位不会被复用，数据仍然有效
+        Task task([this, file, buf, len, fd, gen, slot]()
+                  {
+                      file->recv_record_callback(buf, len);
+                      finish_record(fd, gen, slot);
+                  });
+        post_to_strand(table_[fd].strand, task);
+    }
+
+    // 就绪请求完成，链接了读请求的在读完成时处理
+    void on_poll(int fd, uint32_t gen, int res)
+    {
+        UringEntry &entry = uring_[fd];
+        if (entry.gen != gen || entry.state != ARMED)
+            return;
+
+        if (res < 0)
+        {
+            // 暂时的错误重新提交，链接了读请求的由读请求的完成（-ECANCELED）重新提交
+            if (res == -ECANCELED || res == -EINTR || res == -EAGAIN)
+            {
+                if (entry.slot < 0)
+                    arm(fd);
+                return;
+            }
+            Log::warn("io_uring poll fd " + std::to_string(fd) + " failed: " + std::string(strerror(-res)) + ", stop listening");
+            entry.state = IDLE;
+            return;
+        }
+        if (entry.slot >= 0)
+            return;
+
+        // 同步处理时回调返回后立即重新提交，使用线程池时由工作线程调用rearm()
+        entry.state = BUSY;
+        dispatch(fd);
+        if (!use_thread_pool_ && fd < uring_.size() && uring_[fd].gen == gen && uring_[fd].state == BUSY)
+            arm(fd);
+    }
+
+    // 等待不属于文件的fd（post()的唤醒、定时器）就绪，需要持有锁
+    void arm_internal(int fd)
+    {
+        reserve(1);
+        struct io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = tag(fd, 0, OP_POLL);
+    }
+
+    // 写请求完成
+    void on_write(WriteReq *req, int res)
+    {
+        if (res < 0)
+            Log::warn("io_uring write fd " + std::to_string(req->file->get_fd()) + " failed: " + std::string(strerror(-res)));
+        else if (res < req->data.size())
+            Log::warn("io_uring write fd " + std::to_string(req->file->get_fd()) + " is incomplete");
+        delete req;
+    }
+
+    // 处理所有完成事件，记录是否被post()唤醒、是否有定时器到期
+    void reap(bool &woken, bool &timer_due)
+    {
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+            uint64_t data = cqe->user_data;
+            int res = cqe->res;
+            head++;
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+            Op op = (Op)(data & 3);
+            int fd = (int)(uint32_t)(data >> 2);
+            uint32_t gen = (uint32_t)(data >> 34);
+            if (op == OP_WRITE)
+                on_write((WriteReq *)(data & ~(uint64_t)3), res);
+            else if (op == OP_POLL && fd == wakeup_fd_)
+            {
+                woken = true;
+                arm_internal(wakeup_fd_);
+            }
+            else if (op == OP_POLL && fd == timers_->get_fd())
+            {
+                timer_due = true;
+                arm_internal(timers_->get_fd());
+            }
+            else if (op == OP_CANCEL || fd >= uring_.size())
+                continue;
+            else if (op == OP_READ)
+                on_read(fd, gen, res);
+            else
+                on_poll(fd, gen, res);
+
+            tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        }
+    }
+
+public:
+    FilesListenerUring(bool use_thread_pool)
+        : FilesListener(use_thread_pool)
+    {
+        int entries = atoi(config::get("uring_entries", "256").c_str());
+        int slot_num = atoi(config::get("uring_buffer_slots", "64").c_str());
+        slot_size_ = atoi(config::get("uring_buffer_size", "1024").c_str());
+        if (entries <= 0 || slot_num < 0 || slot_size_ <= 0)
+            UtilError::error_exit("error io_uring setting", false);
+
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ring_fd_ = io_uring_setup(entries, &p);
+        if (ring_fd_ < 0)
+            UtilError::error_exit("io_uring setup error", true);
+
+        map_rings(p);
+        register_buffers(slot_num);
+        arm_internal(wakeup_fd_);
+        arm_internal(timers_->get_fd());
+
+        // 使用线程池时回调结束后由工作线程重新提交
+        rearm_after_callback_ = use_thread_pool;
+        loop_thread_ = std::this_thread::get_id();
+    }
+
+    ~FilesListenerUring()
+    {
+        close(ring_fd_);
+        if (sqes_ != MAP_FAILED)
+            munmap(sqes_, sqes_map_size_);
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+            munmap(cq_ptr_, cq_map_size_);
+        if (sq_ptr_ != MAP_FAILED)
+            munmap(sq_ptr_, sq_map_size_);
+        free(buffers_);
+    }
+
+    // 当前内核是否支持io_uring（需要IORING_FEAT_NODROP，即5.5以上）
+    static bool supported()
+    {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = io_uring_setup(2, &p);
+        if (fd < 0)
+            return false;
+        close(fd);
+        return p.features & IORING_FEAT_NODROP;
+    }
+
+    // 添加要监听的文件
+    bool add_fd(std::shared_ptr<FileDescriptor> file)
+    {
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        if (!FilesListener::add_fd(file))
+            return false;
+
+        int fd = file->get_fd();
+        if (fd >= uring_.size())
+            uring_.resize(fd + 1);
+
+        UringEntry &entry = uring_[fd];
+        entry.slot = -1;
+        entry.got = 0;
+        entry.record_len = file->record_size();
+        if (entry.record_len > 0 && entry.record_len <= slot_size_ && !free_slots_.empty())
+        {
+            entry.slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+
+        arm(fd);
+        if (std::this_thread::get_id() != loop_thread_)
+            submit_now();
+        return true;
+    }
+
+    // 删除要监听的文件，取消未完成的请求
+    bool remove_fd(std::shared_ptr<FileDescriptor> file)
+    {
+        int fd = file->get_fd();
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        if (!FilesListener::remove_fd(file))
+            return false;
+
+        UringEntry &entry = uring_[fd];
+        if (entry.state == ARMED)
+        {
+            reserve(1);
+            struct io_uring_sqe *sqe = get_sqe();
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = tag(fd, entry.gen, OP_POLL);
+            sqe->user_data = OP_CANCEL;
+            if (std::this_thread::get_id() != loop_thread_)
+                submit_now();
+
+            // 读请求完成（被取消）后才能释放槽位
+            if (entry.slot >= 0)
+                retired_slots_.push_back(std::make_pair(fd, std::make_pair(entry.gen, entry.slot)));
+        }
+        // 回调执行中时由finish_record()释放槽位
+        else if (entry.state == IDLE && entry.slot >= 0)
+            free_slots_.push_back(entry.slot);
+
+        entry.gen++;
+        entry.state = IDLE;
+        entry.slot = -1;
+        entry.got = 0;
+        return true;
+    }
+
+    // 通过ring写出数据，数据会被复制，不阻塞调用者，写出结果只记录日志
+    // 在监听线程的回调中调用时随下一次等待一起提交，其他线程调用时立即提交
+    void write_async(std::shared_ptr<FileDescriptor> file, const void *buf, size_t n)
+    {
+        WriteReq *req = new WriteReq();
+        req->file = file;
+        req->data.assign((const char *)buf, n);
+
+        std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+        reserve(1);
+        struct io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = file->get_fd();
+        sqe->addr = (uint64_t)req->data.data();
+        sqe->len = n;
+        sqe->off = (uint64_t)-1;
+        sqe->user_data = (uint64_t)req | OP_WRITE;
+        if (std::this_thread::get_id() != loop_thread_)
+            submit_now();
+    }
+
+    // 监听
+    void listen()
+    {
+        loop_thread_ = std::this_thread::get_id();
+        while (true)
+        {
+            // 提交上一轮重新提交的请求，同时等待至少一个完成事件
+            unsigned n;
+            {
+                std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+                n = take_submit();
+            }
+            int res = io_uring_enter(ring_fd_, n, 1, IORING_ENTER_GETEVENTS);
+            if (res < 0 || res < n)
+            {
+                std::lock_guard<std::recursive_mutex> lock(sq_mutex_);
+                submitted(n, res);
+                if (res < 0 && errno != EINTR)
+                {
+#ifdef DEBUG
+                    // io_uring失败
+                    UtilError::error_exit("io_uring wait failed", true);
+#else
+                    Log::warn("io_uring wait failed");
+#endif
+                }
+            }
+
+            // 处理完成事件，本轮的任务整批送入线程池
+            bool woken = false, timer_due = false;
+            reap(woken, timer_due);
+            flush_dispatch();
+
+            // 执行其他线程送入的任务
+            if (woken)
+            {
+                consume_wakeup();
+                run_posted();
+            }
+
+            // 执行到期的定时器
+            if (timer_due)
+                timers_->expire();
+        }
+    }
+};
+
+#endif
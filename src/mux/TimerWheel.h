@@ -0,0 +1,371 @@
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#include <vector>
+#include <functional>
+
+#include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "src/ThreadPool/ThreadPool.hpp"
+#include "src/log/Log.hpp"
+#include "src/utils/util.hpp"
+
+// 分层时间轮，由一个timerfd驱动，注册在监听器中
+// 4层，每层256个槽，第0层每槽一个tick，上层的定时器在轮到时逐层下降
+// timerfd只在下一个非空的槽（第0层的槽到期或上层的槽降下来）时触发，不会在没有定时器到期的tick唤醒
+// 定时器是侵入式双向链表的节点，添加与取消都是O(1)，节点回收复用
+// 不是线程安全的，只能在事件循环的线程中使用（监听开始前也可以），其他线程通过监听器的post()
+class TimerWheel
+{
+public:
+    // 定时器，节点只会被复用不会被释放，id用于判断句柄是否仍然有效
+    struct Timer
+    {
+        Timer *prev = NULL;
+        Timer *next = NULL;
+        uint64_t id = 0;
+        uint64_t expire = 0; // 到期的tick
+        uint64_t period = 0; // 周期（tick），0表示只执行一次
+        bool in_pool = false;
+        bool running = false;   // 回调执行中
+        bool cancelled = false; // 回调执行中被取消
+        std::function<void()> callback;
+    };
+
+    // 定时器句柄，用于取消
+    struct Handle
+    {
+        Timer *timer = NULL;
+        uint64_t id = 0;
+    };
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 8;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const uint64_t MAX_TICKS = (1ULL << (LEVELS * SLOT_BITS)) - 1;
+
+    // 每个槽是一个带哨兵的循环链表
+    Timer wheel_[LEVELS][SLOTS];
+
+    int timer_fd_;
+    uint64_t tick_ms_;
+    uint64_t start_ms_;
+    uint64_t now_tick_ = 0; // 已经处理到的tick
+    uint64_t next_id_ = 0;
+    size_t count_ = 0;      // 等待中的定时器数
+    uint64_t armed_tick_ = 0; // timerfd到期的tick，0表示停止
+
+    ThreadPool *pool_ = NULL;
+    std::vector<Timer *> free_timers_;
+    std::vector<Timer *> all_timers_;
+
+    static uint64_t monotonic_ms()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    uint64_t current_tick() { return (monotonic_ms() - start_ms_) / tick_ms_; }
+
+    static void list_init(Timer *head) { head->prev = head->next = head; }
+
+    static void list_push(Timer *head, Timer *t)
+    {
+        t->prev = head->prev;
+        t->next = head;
+        head->prev->next = t;
+        head->prev = t;
+    }
+
+    static void list_unlink(Timer *t)
+    {
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+        t->prev = t->next = NULL;
+    }
+
+    // 把整个槽的链表移到head
+    static void list_take(Timer *slot, Timer *head)
+    {
+        list_init(head);
+        if (slot->next == slot)
+            return;
+        head->next = slot->next;
+        head->prev = slot->prev;
+        head->next->prev = head;
+        head->prev->next = head;
+        list_init(slot);
+    }
+
+    // 按到期时间放入对应的层与槽，返回需要处理这个槽的tick（第0层为到期的tick，上层为降下来的tick）
+    uint64_t place(Timer *t)
+    {
+        uint64_t diff = t->expire - now_tick_;
+        int level = 0;
+        while (level < LEVELS - 1 && diff >= (1ULL << ((level + 1) * SLOT_BITS)))
+            level++;
+        int slot = (t->expire >> (level * SLOT_BITS)) & (SLOTS - 1);
+        list_push(&wheel_[level][slot], t);
+        return (t->expire >> (level * SLOT_BITS)) << (level * SLOT_BITS);
+    }
+
+    // 第level层的槽降到下层
+    void cascade(int level, int slot)
+    {
+        Timer head;
+        list_take(&wheel_[level][slot], &head);
+        while (head.next != &head)
+        {
+            Timer *t = head.next;
+            list_unlink(t);
+            place(t);
+        }
+    }
+
+    Timer *alloc_timer()
+    {
+        if (free_timers_.empty())
+        {
+            Timer *t = new Timer();
+            all_timers_.push_back(t);
+            return t;
+        }
+        Timer *t = free_timers_.back();
+        free_timers_.pop_back();
+        return t;
+    }
+
+    void free_timer(Timer *t)
+    {
+        t->id = 0;
+        t->callback = nullptr;
+        free_timers_.push_back(t);
+    }
+
+    static bool slot_empty(const Timer &slot) { return slot.next == &slot; }
+
+    // 下一个需要处理的tick：第0层最早的非空槽，或上层最早要降下来的非空槽，没有时返回0
+    // 两者之间的tick没有任何事情要做，可以直接跳过
+    uint64_t next_tick()
+    {
+        uint64_t next = 0;
+        for (uint64_t tick = now_tick_ + 1; tick <= now_tick_ + SLOTS; tick++)
+            if (!slot_empty(wheel_[0][tick & (SLOTS - 1)]))
+            {
+                next = tick;
+                break;
+            }
+        for (int level = 1; level < LEVELS; level++)
+        {
+            uint64_t round = now_tick_ >> (level * SLOT_BITS);
+            for (uint64_t i = 1; i <= SLOTS; i++)
+            {
+                uint64_t tick = (round + i) << (level * SLOT_BITS);
+                if (next != 0 && tick >= next)
+                    break;
+                if (!slot_empty(wheel_[level][(round + i) & (SLOTS - 1)]))
+                {
+                    next = tick;
+                    break;
+                }
+            }
+        }
+        return next;
+    }
+
+    // timerfd在tick到期时触发一次，0表示停止
+    void arm(uint64_t next)
+    {
+        if (next == armed_tick_)
+            return;
+
+        struct itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        if (next != 0)
+        {
+            // 绝对时间，tick的起点与current_tick()一致
+            uint64_t ms = start_ms_ + next * tick_ms_;
+            spec.it_value.tv_sec = ms / 1000;
+            spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+        }
+        if (timerfd_settime(timer_fd_, next != 0 ? TFD_TIMER_ABSTIME : 0, &spec, NULL) == -1)
+            UtilError::error_exit("timerfd settime error", true);
+        armed_tick_ = next;
+    }
+
+    // 执行到期的定时器，周期定时器重新放入时间轮
+    void run(Timer *t)
+    {
+        if (t->in_pool && pool_ != NULL)
+        {
+            if (t->period == 0)
+                pool_->post(std::move(t->callback));
+            else
+                pool_->post(t->callback);
+        }
+        else
+        {
+            t->running = true;
+            t->callback();
+            t->running = false;
+        }
+
+        if (t->period > 0 && !t->cancelled)
+        {
+            t->expire += t->period;
+            if (t->expire <= now_tick_)
+                t->expire = now_tick_ + 1;
+            place(t);
+            return;
+        }
+
+        count_--;
+        free_timer(t);
+    }
+
+    // 前进一个tick
+    void step()
+    {
+        now_tick_++;
+
+        // 每层转完一圈时上层的一个槽降下来
+        for (int level = 1; level < LEVELS; level++)
+        {
+            if ((now_tick_ & ((1ULL << (level * SLOT_BITS)) - 1)) != 0)
+                break;
+            cascade(level, (now_tick_ >> (level * SLOT_BITS)) & (SLOTS - 1));
+        }
+
+        Timer head;
+        list_take(&wheel_[0][now_tick_ & (SLOTS - 1)], &head);
+        while (head.next != &head)
+        {
+            Timer *t = head.next;
+            list_unlink(t);
+            run(t);
+        }
+    }
+
+public:
+    // tick_ms为时间轮的精度，由配置项timer_tick_ms决定（默认10毫秒）
+    TimerWheel(uint64_t tick_ms) : tick_ms_(tick_ms)
+    {
+        if (tick_ms_ == 0)
+            UtilError::error_exit("error timer_tick_ms setting", false);
+
+        for (int level = 0; level < LEVELS; level++)
+            for (int slot = 0; slot < SLOTS; slot++)
+                list_init(&wheel_[level][slot]);
+
+        timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timer_fd_ == -1)
+            UtilError::error_exit("timerfd create error", true);
+        start_ms_ = monotonic_ms();
+    }
+
+    ~TimerWheel()
+    {
+        close(timer_fd_);
+        for (Timer *t : all_timers_)
+            delete t;
+    }
+
+    // 禁用拷贝、赋值
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // 设置执行in_pool定时器的线程池，没有线程池时在事件循环中执行
+    void set_pool(ThreadPool *pool) { pool_ = pool; }
+
+    int get_fd() { return timer_fd_; }
+    size_t size() { return count_; }
+
+    // delay_ms毫秒后执行callback，period_ms大于0时之后每period_ms毫秒执行一次
+    // in_pool为true时回调送入线程池执行，否则在事件循环的线程中执行
+    Handle schedule(uint64_t delay_ms, std::function<void()> callback, uint64_t period_ms = 0, bool in_pool = false)
+    {
+        // 没有定时器时timerfd停止，时间轮直接跳到当前时间
+        if (count_ == 0)
+            now_tick_ = std::max(now_tick_, current_tick());
+
+        uint64_t ticks = std::max<uint64_t>(1, (delay_ms + tick_ms_ - 1) / tick_ms_);
+        uint64_t expire = std::max(current_tick() + ticks, now_tick_ + 1);
+        if (expire - now_tick_ > MAX_TICKS)
+            expire = now_tick_ + MAX_TICKS;
+
+        Timer *t = alloc_timer();
+        t->id = ++next_id_;
+        t->expire = expire;
+        t->period = period_ms == 0 ? 0 : std::max<uint64_t>(1, (period_ms + tick_ms_ - 1) / tick_ms_);
+        t->in_pool = in_pool;
+        t->running = false;
+        t->cancelled = false;
+        t->callback = std::move(callback);
+        uint64_t tick = place(t);
+
+        // 比timerfd更早需要处理时提前触发，否则不变
+        count_++;
+        if (armed_tick_ == 0 || tick < armed_tick_)
+            arm(tick);
+
+        Handle h;
+        h.timer = t;
+        h.id = t->id;
+        return h;
+    }
+
+    // 取消定时器，已经执行或取消过的返回false
+    bool cancel(Handle h)
+    {
+        Timer *t = h.timer;
+        if (t == NULL || t->id != h.id || t->cancelled)
+            return false;
+
+        // 回调执行中（比如周期定时器在回调中取消自己），执行完后释放
+        if (t->running)
+        {
+            t->cancelled = true;
+            return true;
+        }
+
+        list_unlink(t);
+        count_--;
+        free_timer(t);
+        // 还有定时器时不重新计算，timerfd提前触发时expire()会重新设置
+        if (count_ == 0)
+            arm(0);
+        return true;
+    }
+
+    // timerfd就绪时调用，执行所有到期的定时器
+    void expire()
+    {
+        uint64_t times;
+        if (read(timer_fd_, &times, sizeof(times)) == -1 && errno != EAGAIN)
+            Log::warn("read timerfd failed: " + std::string(strerror(errno)));
+
+        // timerfd已经触发，需要重新设置
+        armed_tick_ = 0;
+
+        // 直接跳到下一个非空的槽，中间的tick没有定时器到期，也没有非空的槽要降下来
+        uint64_t target = current_tick();
+        while (now_tick_ < target && count_ > 0)
+        {
+            uint64_t next = next_tick();
+            if (next == 0 || next > target)
+                break;
+            now_tick_ = next - 1;
+            step();
+        }
+        now_tick_ = std::max(now_tick_, target);
+        arm(count_ > 0 ? next_tick() : 0);
+    }
+};
+
+#endif
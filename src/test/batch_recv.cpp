@@ -0,0 +1,163 @@
+#include "src/fd/NamedPipe.h"
+
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 与聊天消息大小相近的消息
+struct TestMsg
+{
+    int value;
+    char data[192];
+};
+
+const string PATH = "/tmp/fifo_framework_batch";
+
+TestMsg make_msg(int i)
+{
+    TestMsg msg;
+    msg.value = i;
+    memset(msg.data, i, sizeof(msg.data));
+    return msg;
+}
+
+void check_msg(const TestMsg &msg, int i)
+{
+    assert(msg.value == i);
+    for (size_t j = 0; j < sizeof(msg.data); j++)
+        assert(msg.data[j] == (char)i);
+}
+
+// 一次读取多条消息，批量处理函数按顺序收到所有消息
+void test_batch(ReadOnlyFIFO<TestMsg> &reader, WriteOnlyFIFO<TestMsg> &writer)
+{
+    const int N = 100;
+    int next = 0, calls = 0;
+    reader.set_batch_size(16);
+    reader.set_batch_process_func([&next, &calls](const TestMsg *msgs, size_t n) -> bool
+                                  {
+                                      assert(n > 0 && n <= 16);
+                                      for (size_t i = 0; i < n; i++)
+                                          check_msg(msgs[i], next++);
+                                      calls++;
+                                      return true;
+                                  });
+
+    vector<TestMsg> msgs;
+    for (int i = 0; i < N; i++)
+        msgs.push_back(make_msg(i));
+    writer.send_many(msgs);
+    while (reader.recv_and_process())
+        ;
+    assert(next == N);
+    assert(calls == (N + 15) / 16);
+    cout << "batch recv success" << endl;
+}
+
+// 消息被拆成多次写入时，不完整的部分留到下次读取补全
+void test_partial(ReadOnlyFIFO<TestMsg> &reader, WriteOnlyFIFO<TestMsg> &writer)
+{
+    int next = 0;
+    reader.set_batch_process_func([&next](const TestMsg *msgs, size_t n) -> bool
+                                  {
+                                      for (size_t i = 0; i < n; i++)
+                                          check_msg(msgs[i], next++);
+                                      return true;
+                                  });
+
+    TestMsg msgs[3] = {make_msg(0), make_msg(1), make_msg(2)};
+    const char *bytes = (const char *)msgs;
+    size_t cuts[] = {10, sizeof(TestMsg) + 5, sizeof(msgs)};
+    size_t begin = 0;
+    for (size_t cut : cuts)
+    {
+        assert(write(writer.get_fd(), bytes + begin, cut - begin) == (int)(cut - begin));
+        begin = cut;
+        assert(reader.recv_and_process());
+    }
+    assert(next == 3);
+    assert(!reader.recv_and_process());
+    cout << "batch recv partial success" << endl;
+}
+
+// 逐条的处理函数建立在批量读取之上，边缘触发时处理的消息数不超过预算
+void test_single()
+{
+    ReadOnlyFIFO<TestMsg> single(PATH + "_single");
+    single.createfile();
+    single.openfile();
+    WriteOnlyFIFO<TestMsg> single_writer(PATH + "_single");
+    single_writer.openfile();
+
+    int next = 0;
+    single.set_batch_size(16);
+    single.set_process_func([&next](TestMsg msg) -> bool
+                            {
+                                check_msg(msg, next++);
+                                return true;
+                            });
+
+    vector<TestMsg> msgs;
+    for (int i = 0; i < 40; i++)
+        msgs.push_back(make_msg(i));
+    single_writer.send_many(msgs);
+    assert(!single.drain_callback(10));
+    assert(next == 10);
+    assert(single.drain_callback(100));
+    assert(next == 40);
+
+    single_writer.closefile();
+    single.closefile();
+    single.deletefile();
+    cout << "batch recv single success" << endl;
+}
+
+// 逐条读取与批量读取的速度
+void bench(ReadOnlyFIFO<TestMsg> &reader, WriteOnlyFIFO<TestMsg> &writer)
+{
+    const int N = 200000, CHUNK = 256;
+    vector<TestMsg> msgs(CHUNK, make_msg(0));
+    long long received = 0;
+    reader.set_batch_process_func([&received](const TestMsg *msgs, size_t n) -> bool
+                                  {
+                                      received += n;
+                                      return true;
+                                  });
+
+    for (size_t batch : {1, 32})
+    {
+        reader.set_batch_size(batch);
+        double seconds = 0;
+        received = 0;
+        for (int i = 0; i < N; i += CHUNK)
+        {
+            writer.send_many(msgs);
+            auto start = chrono::steady_clock::now();
+            while (reader.recv_and_process())
+                ;
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+        assert(received == (N + CHUNK - 1) / CHUNK * CHUNK);
+        cout << "batch size " << batch << ": " << received / seconds / 1e6 << " M msgs/s" << endl;
+    }
+}
+
+int main()
+{
+    ReadOnlyFIFO<TestMsg> reader(PATH);
+    reader.createfile();
+    reader.openfile();
+    WriteOnlyFIFO<TestMsg> writer(PATH);
+    writer.openfile();
+
+    test_batch(reader, writer);
+    test_partial(reader, writer);
+    test_single();
+    bench(reader, writer);
+
+    writer.closefile();
+    reader.closefile();
+    reader.deletefile();
+}
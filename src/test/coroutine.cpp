@@ -0,0 +1,196 @@
+#include "src/mux/Coroutine.h"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+struct Request
+{
+    int id;
+    int delay_ms;
+};
+
+struct Reply
+{
+    int id;
+};
+
+// 大消息，少量就能写满管道
+struct Block
+{
+    int seq;
+    char data[1020];
+};
+
+// 处理一个请求：等待一段时间后回复，期间不阻塞事件循环
+Coroutine handle(FilesListenerEpoll &listener, AsyncWriteFIFO<Reply> &replies, Request req)
+{
+    co_await async_sleep(listener, req.delay_ms);
+    co_await replies.send_msg(Reply{req.id});
+}
+
+// 不断接收请求，每个请求一个协程，同时处理
+Coroutine serve(FilesListenerEpoll &listener, AsyncReadFIFO<Request> &requests, AsyncWriteFIFO<Reply> &replies)
+{
+    while (true)
+    {
+        Request req = co_await requests.recv_msg();
+        handle(listener, replies, req);
+    }
+}
+
+// 收集n条回复
+Coroutine collect(AsyncReadFIFO<Reply> &replies, vector<int> &got, atomic<int> &done, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        Reply reply = co_await replies.recv_msg();
+        got[reply.id]++;
+    }
+    done++;
+}
+
+// 大量同时进行的请求，延迟不同，检查每个请求恰好回复一次
+void test_requests(FilesListenerEpoll &listener)
+{
+    const int N = 2000;
+    auto requests = make_shared<AsyncReadFIFO<Request>>(listener, "/tmp/fifo_framework_co_req");
+    auto replies_in = make_shared<AsyncReadFIFO<Reply>>(listener, "/tmp/fifo_framework_co_rep");
+    requests->createfile();
+    replies_in->createfile();
+    AsyncWriteFIFO<Reply> replies_out(listener, "/tmp/fifo_framework_co_rep");
+
+    vector<int> got(N, 0);
+    atomic<int> done{0};
+    listener.post([&]()
+                  {
+                      serve(listener, *requests, replies_out);
+                      collect(*replies_in, got, done, N);
+                  });
+
+    // 请求从其他线程以普通的同步接口发送，不超过管道容量
+    WriteOnlyFIFO<Request> writer("/tmp/fifo_framework_co_req");
+    writer.openfile();
+    for (int i = 0; i < N; i++)
+    {
+        Request req;
+        req.id = i;
+        req.delay_ms = (i * 7) % 50;
+        writer.send_msg(req);
+    }
+
+    while (done.load() != 1)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    for (int i = 0; i < N; i++)
+        assert(got[i] == 1);
+    cout << "coroutine requests success" << endl;
+}
+
+Coroutine produce(AsyncWriteFIFO<Block> &out, int n, atomic<int> &done)
+{
+    for (int i = 0; i < n; i++)
+    {
+        Block block;
+        block.seq = i;
+        co_await out.send_msg(block);
+    }
+    done++;
+}
+
+Coroutine consume(FilesListenerEpoll &listener, AsyncReadFIFO<Block> &in, int n, atomic<int> &done)
+{
+    // 先让发送方写满管道，发送方应该挂起在管道上
+    co_await async_sleep(listener, 50);
+    assert(done.load() == 0);
+    for (int i = 0; i < n; i++)
+    {
+        Block block = co_await in.recv_msg();
+        assert(block.seq == i);
+    }
+    done++;
+}
+
+// 发送的数据超过管道容量，发送方挂起等待可写，检查顺序与完整性
+void test_backpressure(FilesListenerEpoll &listener)
+{
+    const int N = 1000;
+    string path = "/tmp/fifo_framework_co_block";
+    auto in = make_shared<AsyncReadFIFO<Block>>(listener, path);
+    in->createfile();
+    AsyncWriteFIFO<Block> out(listener, path);
+
+    atomic<int> done{0};
+    listener.post([&]()
+                  {
+                      produce(out, N / 2, done);
+                      consume(listener, *in, N / 2, done);
+                  });
+    while (done.load() != 2)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    cout << "coroutine backpressure success" << endl;
+}
+
+Coroutine wait_one(AsyncReadFIFO<Reply> &in, atomic<int> &done)
+{
+    co_await in.recv_msg();
+    done++;
+}
+
+// 有协程等待时析构管道，等待被取消；fd号被新的管道重用后可以正常等待
+void test_destroy(FilesListenerEpoll &listener)
+{
+    auto old_pipe = new AsyncReadFIFO<Reply>(listener, "/tmp/fifo_framework_co_old");
+    old_pipe->createfile();
+    atomic<int> done{0};
+    atomic<int> step{0};
+    int old_fd = -1;
+    listener.post([&]()
+                  {
+                      // 没有消息，协程挂起等待可读
+                      wait_one(*old_pipe, done);
+                      old_fd = old_pipe->get_fd();
+                      delete old_pipe;
+                      step++;
+                  });
+    while (step.load() != 1)
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    AsyncReadFIFO<Reply> new_pipe(listener, "/tmp/fifo_framework_co_new");
+    new_pipe.createfile();
+    listener.post([&]()
+                  {
+                      wait_one(new_pipe, done);
+                      step++;
+                  });
+    while (step.load() != 2)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    assert(new_pipe.get_fd() == old_fd);
+
+    WriteOnlyFIFO<Reply> writer("/tmp/fifo_framework_co_new");
+    writer.openfile();
+    Reply reply;
+    reply.id = 0;
+    writer.send_msg(reply);
+    while (done.load() != 1)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    cout << "coroutine destroy success" << endl;
+}
+
+int main()
+{
+    // 协程在事件循环的线程中恢复，不使用线程池
+    FilesListenerEpoll listener(false);
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    test_requests(listener);
+    test_backpressure(listener);
+    test_destroy(listener);
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
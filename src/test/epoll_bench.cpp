@@ -0,0 +1,109 @@
+#include "src/fd/Stdio.hpp"
+
+#include <map>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <iostream>
+
+#include <sys/epoll.h>
+
+using namespace std;
+
+// 比较epoll事件循环中每个事件的分发开销：
+// 旧：每轮new事件数组、按最大fd决定大小、std::map查找并复制shared_ptr
+// 新：预先分配的事件数组、以fd为下标的裸指针表
+
+// 只计数的文件，不读数据，管道一直处于就绪状态
+class BenchFile : public Stdio
+{
+public:
+    long long count = 0;
+    BenchFile() : Stdio(FileOpenMode::ReadOnly) {}
+    void recv_callback() { count++; }
+    void eof_callback(int err) {}
+};
+
+const int PIPE_NUM = 64;
+const int ROUNDS = 20000;
+
+// 旧的循环
+double bench_old(int epoll_fd, map<int, shared_ptr<FileDescriptor>> &files)
+{
+    auto start = chrono::steady_clock::now();
+    long long events_num = 0;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        int max_fd = files.rbegin()->first;
+        struct epoll_event *events = new epoll_event[max_fd + 1];
+        int nfds = epoll_wait(epoll_fd, events, max_fd + 1, -1);
+        for (int i = 0; i < nfds; i++)
+        {
+            if (events[i].events & EPOLLIN)
+            {
+                auto file = files[events[i].data.fd];
+                file->recv_callback();
+            }
+        }
+        events_num += nfds;
+        // 原来的实现没有释放，这里释放以免压测时内存暴涨
+        delete[] events;
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / events_num;
+}
+
+// 新的循环
+double bench_new(int epoll_fd, vector<FileDescriptor *> &table, int max_events)
+{
+    vector<struct epoll_event> events(max_events);
+    auto start = chrono::steady_clock::now();
+    long long events_num = 0;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        int nfds = epoll_wait(epoll_fd, events.data(), events.size(), -1);
+        for (int i = 0; i < nfds; i++)
+        {
+            if (events[i].events & EPOLLIN)
+                table[events[i].data.fd]->recv_callback();
+        }
+        events_num += nfds;
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count() / events_num;
+}
+
+int main()
+{
+    int epoll_fd = epoll_create(256);
+    map<int, shared_ptr<FileDescriptor>> files;
+    vector<FileDescriptor *> table;
+
+    // 每个管道写入1字节，水平触发下一直就绪
+    for (int i = 0; i < PIPE_NUM; i++)
+    {
+        int p[2];
+        if (pipe(p) != 0)
+            UtilError::error_exit("pipe failed", true);
+        char c = 'x';
+        if (write(p[1], &c, 1) != 1)
+            UtilError::error_exit("write failed", true);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = p[0];
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, p[0], &ev);
+
+        auto file = make_shared<BenchFile>();
+        files[p[0]] = file;
+        if (p[0] >= table.size())
+            table.resize(p[0] + 1);
+        table[p[0]] = file.get();
+    }
+
+    double old_ns = bench_old(epoll_fd, files);
+    double new_ns = bench_new(epoll_fd, table, PIPE_NUM);
+    cout << PIPE_NUM << " ready fds, " << ROUNDS << " rounds" << endl;
+    cout << "old loop: " << old_ns << " ns/event" << endl;
+    cout << "new loop: " << new_ns << " ns/event" << endl;
+}
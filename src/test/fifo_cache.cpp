@@ -0,0 +1,131 @@
+#include "src/fd/FIFOCache.h"
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+struct TestMsg
+{
+    int value;
+};
+
+const string DIR = "/tmp/fifo_framework_cache_";
+
+// 读出管道中所有消息的数量
+int drain(ReadOnlyFIFO<TestMsg> &reader)
+{
+    int n = 0;
+    TestMsg msg;
+    while (reader.recv_msg(msg))
+        n++;
+    return n;
+}
+
+// 命中、淘汰最久未使用的、重新打开、删除
+void test_lru(vector<shared_ptr<ReadOnlyFIFO<TestMsg>>> &readers)
+{
+    FIFOCache cache(DIR, 2);
+    auto a = cache.get("0");
+    assert(cache.get("0") == a);
+    auto b = cache.get("1");
+
+    // 使用0之后放入2，淘汰1
+    cache.get("0");
+    cache.get("2");
+    assert(cache.size() == 2);
+    assert(cache.get("0") == a);
+    assert(cache.get("1") != b);
+
+    // 读端没有重新创建管道时继续使用原来的，重新创建后得到新的管道
+    assert(cache.reopen("0") == a);
+    readers[0]->closefile();
+    readers[0]->deletefile();
+    readers[0]->createfile();
+    readers[0]->openfile();
+    auto a2 = cache.reopen("0");
+    assert(a2 != a && cache.get("0") == a2);
+
+    // 已被删除的管道在持有者手中仍然可以写
+    assert(cache.evict("0"));
+    assert(!cache.evict("0"));
+    TestMsg msg;
+    msg.value = 1;
+    assert(a2->send(msg));
+    assert(drain(*readers[0]) == 1);
+
+    // 最后一个持有者释放时关闭
+    int fd = a2->get_fd();
+    a.reset();
+    a2.reset();
+    assert(!UtilFile::is_valid_fd(fd));
+    cout << "fifo cache lru success" << endl;
+}
+
+// 一次性的回复不放入缓存，在缓存中时使用缓存的管道
+void test_send_once(vector<shared_ptr<ReadOnlyFIFO<TestMsg>>> &readers)
+{
+    FIFOCache cache(DIR, 2);
+    TestMsg msg;
+    msg.value = 1;
+    assert(cache.send_once("3", msg));
+    assert(cache.size() == 0);
+    assert(drain(*readers[3]) == 1);
+
+    auto fifo = cache.get("3");
+    assert(cache.send_once("3", msg));
+    assert(cache.size() == 1 && cache.get("3") == fifo);
+    assert(drain(*readers[3]) == 1);
+    cout << "fifo cache send once success" << endl;
+}
+
+// 多个线程通过容量较小的缓存同时发送，检查消息没有丢失
+void test_threads(vector<shared_ptr<ReadOnlyFIFO<TestMsg>>> &readers)
+{
+    const int THREADS = 4, N = 1000;
+    FIFOCache cache(DIR, 3);
+    vector<thread> threads;
+    for (int t = 0; t < THREADS; t++)
+        threads.emplace_back([&cache, &readers, t]()
+                             {
+                                 for (int i = 0; i < N; i++)
+                                 {
+                                     TestMsg msg;
+                                     msg.value = i;
+                                     cache.get(to_string((i + t) % readers.size()))->send(msg);
+                                 }
+                             });
+    for (auto &t : threads)
+        t.join();
+
+    int total = 0;
+    for (auto &reader : readers)
+        total += drain(*reader);
+    assert(total == THREADS * N);
+    assert(cache.size() == 3);
+    cout << "fifo cache threads success" << endl;
+}
+
+int main()
+{
+    vector<shared_ptr<ReadOnlyFIFO<TestMsg>>> readers;
+    for (int i = 0; i < 8; i++)
+    {
+        auto reader = make_shared<ReadOnlyFIFO<TestMsg>>(DIR + to_string(i));
+        reader->createfile();
+        reader->openfile();
+        readers.push_back(reader);
+    }
+
+    test_lru(readers);
+    test_send_once(readers);
+    test_threads(readers);
+
+    for (auto &reader : readers)
+    {
+        reader->closefile();
+        reader->deletefile();
+    }
+}
@@ -0,0 +1,255 @@
+#include "src/fd/NamedPipe.h"
+
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+
+using namespace std;
+
+// 与聊天消息相同的结构：消息头用于路由，内容直接转发
+// 开启forward_splice且BODY_SIZE不小于forward_splice_min时使用splice/tee，否则读出后写入
+template <size_t BODY_SIZE>
+struct ChatMsg
+{
+    int type;
+    char from[64];
+    char to[64];
+    char msg[BODY_SIZE];
+};
+
+typedef ChatMsg<64> SmallMsg;
+typedef ChatMsg<16384> LargeMsg;
+
+template <typename Msg>
+size_t head_size() { return offsetof(Msg, msg); }
+
+template <typename Msg>
+size_t body_size() { return sizeof(Msg) - head_size<Msg>(); }
+
+template <typename Msg>
+shared_ptr<Msg> make_msg(int i)
+{
+    auto m = make_shared<Msg>();
+    m->type = i;
+    snprintf(m->from, sizeof(m->from), "from%d", i);
+    snprintf(m->to, sizeof(m->to), "to%d", i);
+    for (size_t j = 0; j < sizeof(m->msg); j++)
+        m->msg[j] = (char)(i + j * 13);
+    return m;
+}
+
+template <typename Msg>
+void check_msg(ReadOnlyFIFO<Msg> &out, int i)
+{
+    auto m = make_shared<Msg>();
+    assert(out.recv_msg(*m));
+    assert(memcmp(m.get(), make_msg<Msg>(i).get(), sizeof(Msg)) == 0);
+}
+
+// 读出消息头，把内容转发到dsts
+template <typename Msg>
+void forward_one(ReadOnlyFIFO<Msg> &in, vector<FileDescriptor *> dsts)
+{
+    Msg head;
+    assert(in.readfile(&head, head_size<Msg>()) == (int)head_size<Msg>());
+    assert(in.forward_to(dsts, body_size<Msg>(), &head, head_size<Msg>()));
+}
+
+// 一组输入、输出管道
+template <typename Msg>
+struct Pipes
+{
+    ReadOnlyFIFO<Msg> in;
+    WriteOnlyFIFO<Msg> writer;
+    vector<shared_ptr<ReadOnlyFIFO<Msg>>> outs;
+
+    Pipes(const string &path, bool use_splice) : in(path), writer(path)
+    {
+        in.createfile();
+        in.openfile();
+        in.set_forward_splice(use_splice);
+        writer.openfile();
+        for (int i = 0; i < 3; i++)
+        {
+            auto out = make_shared<ReadOnlyFIFO<Msg>>(path + to_string(i));
+            out->createfile();
+            out->openfile();
+            outs.push_back(out);
+        }
+    }
+
+    ~Pipes()
+    {
+        for (auto &out : outs)
+        {
+            out->closefile();
+            out->deletefile();
+        }
+        writer.closefile();
+        in.closefile();
+        in.deletefile();
+    }
+};
+
+// 转发到一个和多个目标，目标收到完整的消息
+template <typename Msg>
+void test_forward(Pipes<Msg> &pipes, const string &name)
+{
+    const int N = 100;
+    for (int i = 0; i < N; i++)
+    {
+        pipes.writer.send_msg(*make_msg<Msg>(i));
+        vector<FileDescriptor *> dsts;
+        for (size_t j = 0; j <= i % pipes.outs.size(); j++)
+            dsts.push_back(pipes.outs[j].get());
+        forward_one(pipes.in, dsts);
+
+        for (size_t j = 0; j < dsts.size(); j++)
+            check_msg(*pipes.outs[j], i);
+    }
+
+    Msg m;
+    for (auto &out : pipes.outs)
+        assert(!out->recv_msg(m));
+    cout << name << " forward success" << endl;
+}
+
+// 目标管道已满时等待读端读走，已写入一部分的目标补写剩下的数据
+template <typename Msg>
+void test_full(Pipes<Msg> &pipes, const string &name)
+{
+    // 写满第一个目标
+    int fd = pipes.outs[0]->get_fd();
+    int filled = 0;
+    char byte = 'x';
+    while (write(fd, &byte, 1) == 1)
+        filled++;
+
+    pipes.writer.send_msg(*make_msg<Msg>(7));
+    thread drainer([fd, filled]()
+                   {
+                       this_thread::sleep_for(chrono::milliseconds(50));
+                       char c;
+                       for (int i = 0; i < filled; i++)
+                           assert(read(fd, &c, 1) == 1 && c == 'x');
+                   });
+    forward_one(pipes.in, {pipes.outs[0].get(), pipes.outs[1].get()});
+    drainer.join();
+
+    check_msg(*pipes.outs[0], 7);
+    check_msg(*pipes.outs[1], 7);
+    cout << name << " forward full success" << endl;
+}
+
+// 内容分两次写入，转发期间来源暂时没有数据时等待可读，不空转
+template <typename Msg>
+void test_slow_source(Pipes<Msg> &pipes, const string &name)
+{
+    auto msg = make_msg<Msg>(9);
+    const char *bytes = (const char *)msg.get();
+    size_t first = head_size<Msg>() + body_size<Msg>() / 2;
+    assert(write(pipes.writer.get_fd(), bytes, first) == (int)first);
+    thread writer([&pipes, bytes, first]()
+                  {
+                      this_thread::sleep_for(chrono::milliseconds(100));
+                      size_t rest = sizeof(Msg) - first;
+                      assert(write(pipes.writer.get_fd(), bytes + first, rest) == (int)rest);
+                  });
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &begin);
+    forward_one(pipes.in, {pipes.outs[0].get()});
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    writer.join();
+
+    check_msg(*pipes.outs[0], 9);
+    double cpu_ms = (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6;
+    assert(cpu_ms < 50);
+    cout << name << " forward slow source success" << endl;
+}
+
+// 目标一直是满的，等待超时后返回false，来源中的内容不变
+template <typename Msg>
+void test_timeout(Pipes<Msg> &pipes, const string &name)
+{
+    int fd = pipes.outs[0]->get_fd();
+    int filled = 0;
+    char byte = 'x';
+    while (write(fd, &byte, 1) == 1)
+        filled++;
+
+    auto msg = make_msg<Msg>(5);
+    pipes.writer.send_msg(*msg);
+    Msg head;
+    assert(pipes.in.readfile(&head, head_size<Msg>()) == (int)head_size<Msg>());
+    pipes.in.set_forward_timeout(50);
+    auto start = chrono::steady_clock::now();
+    assert(!pipes.in.forward_to(*pipes.outs[0], body_size<Msg>(), &head, head_size<Msg>()));
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    assert(elapsed >= 50 && elapsed < 1000);
+    pipes.in.set_forward_timeout(1000);
+
+    vector<char> body(body_size<Msg>());
+    assert(pipes.in.readfile(body.data(), body.size()) == (int)body.size());
+    assert(memcmp(body.data(), (const char *)msg.get() + head_size<Msg>(), body.size()) == 0);
+    char c;
+    for (int i = 0; i < filled; i++)
+        assert(read(fd, &c, 1) == 1);
+    cout << name << " forward timeout success" << endl;
+}
+
+// 转发与读出再写入的速度
+template <typename Msg>
+void bench(Pipes<Msg> &pipes, const string &name)
+{
+    const int N = 20000;
+    auto msg = make_msg<Msg>(0);
+    ReadOnlyFIFO<Msg> &out = *pipes.outs[0];
+    const char *modes[] = {" read + write: ", " forward_to copy: ", " forward_to splice: "};
+    for (int mode = 0; mode < 3; mode++)
+    {
+        pipes.in.set_forward_splice(mode == 2);
+        double seconds = 0;
+        for (int i = 0; i < N; i++)
+        {
+            pipes.writer.send_msg(*msg);
+
+            auto start = chrono::steady_clock::now();
+            if (mode > 0)
+                forward_one(pipes.in, {&out});
+            else
+            {
+                pipes.in.recv_msg(*msg);
+                write(out.get_fd(), msg.get(), sizeof(Msg));
+            }
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            out.recv_msg(*msg);
+        }
+        cout << name << modes[mode] << N / seconds / 1e6 << " M msgs/s" << endl;
+    }
+}
+
+int main()
+{
+    Pipes<SmallMsg> small("/tmp/fifo_framework_forward_small", false);
+    test_forward(small, "small");
+    test_full(small, "small");
+    test_timeout(small, "small");
+    bench(small, "small");
+
+    // 大消息分别测试读出写入与splice/tee
+    for (int use_splice = 0; use_splice < 2; use_splice++)
+    {
+        string name = use_splice ? "large splice" : "large copy";
+        Pipes<LargeMsg> large("/tmp/fifo_framework_forward_large", use_splice);
+        test_forward(large, name);
+        test_full(large, name);
+        test_slow_source(large, name);
+        test_timeout(large, name);
+        if (use_splice)
+            bench(large, "large");
+    }
+}
@@ -0,0 +1,213 @@
+#include "src/fd/FramedPipe.h"
+#include "src/mux/FilesListenerEpoll.h"
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 运行时的监听方式由app.conf决定（比如epoll_edge_triggered）
+
+enum FrameType : uint32_t
+{
+    Text,
+    Blob,
+    Point
+};
+
+struct PointMsg
+{
+    int x;
+    int y;
+};
+
+// 第i个大帧的内容
+string make_blob(int i, size_t n)
+{
+    string blob(n, 0);
+    for (size_t j = 0; j < n; j++)
+        blob[j] = (char)(i * 31 + j * 7);
+    return blob;
+}
+
+// 直接写入原始字节，模拟一帧被拆成多次到达
+void write_raw(int fd, const void *buf, size_t n)
+{
+    assert(write(fd, buf, n) == (int)n);
+}
+
+// 帧头与内容被拆开写入，读端跨多次读取拼出完整的帧
+void test_partial()
+{
+    string path = "/tmp/fifo_framework_frame_partial";
+    FramedPipe reader(path, FileOpenMode::ReadOnly);
+    reader.createfile();
+    reader.openfile();
+
+    vector<string> texts;
+    reader.set_frame_func(Text, [&texts](const char *payload, size_t n) -> bool
+                          {
+                              texts.push_back(string(payload, n));
+                              return true;
+                          });
+
+    FramedPipe writer(path, FileOpenMode::WriteOnly);
+    writer.openfile();
+
+    // 两帧的字节逐段写入
+    string data;
+    for (string text : {string("hello"), string("")})
+    {
+        FrameHeader header;
+        header.type = Text;
+        header.length = text.size();
+        data += string((char *)&header, sizeof(header)) + text;
+    }
+    for (size_t i = 0; i < data.size(); i += 3)
+    {
+        write_raw(writer.get_fd(), data.data() + i, min<size_t>(3, data.size() - i));
+        reader.recv_callback();
+    }
+    assert(texts.size() == 2 && texts[0] == "hello" && texts[1] == "");
+
+    // 没有处理函数的类型与长度不符的帧被丢弃，后面的帧不受影响
+    int points = 0;
+    reader.set_msg_func<PointMsg>(Point, [&points](PointMsg msg) -> bool
+                                  {
+                                      assert(msg.x == 1 && msg.y == 2);
+                                      points++;
+                                      return true;
+                                  });
+    writer.send_frame(Blob, "xyz", 3);
+    writer.send_frame(Point, "xyz", 3);
+    writer.send_frame(Point, PointMsg{1, 2});
+    reader.recv_callback();
+    assert(points == 1);
+
+    writer.closefile();
+    reader.closefile();
+    reader.deletefile();
+    cout << "frame partial success" << endl;
+}
+
+// 读端不读时，还没写出的帧等待超时返回false；已经写出一部分的帧超时后仍然写完
+void test_send_timeout()
+{
+    string path = "/tmp/fifo_framework_frame_timeout";
+    FramedPipe reader(path, FileOpenMode::ReadOnly);
+    reader.createfile();
+    reader.openfile();
+    int texts = 0;
+    string got_blob;
+    atomic<bool> blob_done{false};
+    reader.set_frame_func(Text, [&texts](const char *payload, size_t n) -> bool
+                          {
+                              assert(n == 1000);
+                              texts++;
+                              return true;
+                          });
+    reader.set_frame_func(Blob, [&got_blob, &blob_done](const char *payload, size_t n) -> bool
+                          {
+                              got_blob.assign(payload, n);
+                              blob_done = true;
+                              return true;
+                          });
+
+    FramedPipe writer(path, FileOpenMode::WriteOnly);
+    writer.openfile();
+    writer.set_send_timeout(50);
+
+    string text(1000, 't');
+    int sent = 0;
+    auto start = chrono::steady_clock::now();
+    while (writer.send_frame(Text, text.data(), text.size()))
+        sent++;
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    assert(sent > 0 && elapsed >= 50 && elapsed < 2000);
+    while (reader.recv_and_process() > 0)
+        ;
+    assert(texts == sent);
+
+    // 比管道容量大的帧，读端在超时之后才开始读
+    string blob = make_blob(3, 300000);
+    atomic<bool> done{false};
+    thread slow_reader([&reader, &done]()
+                       {
+                           this_thread::sleep_for(chrono::milliseconds(200));
+                           while (!done.load())
+                               reader.recv_and_process();
+                       });
+    assert(writer.send_frame(Blob, blob.data(), blob.size()));
+    while (!blob_done.load())
+        this_thread::sleep_for(chrono::milliseconds(1));
+    done = true;
+    slow_reader.join();
+    assert(got_blob == blob);
+
+    writer.closefile();
+    reader.closefile();
+    reader.deletefile();
+    cout << "frame send timeout success" << endl;
+}
+
+// 比管道容量大的帧：写端等待可写，读端由监听器在多次就绪中拼接
+void test_large(FilesListener &listener, const string &name)
+{
+    const int N = 20;
+    const size_t SIZE = 200000;
+    string path = "/tmp/fifo_framework_frame_" + name;
+    auto reader = make_shared<FramedPipe>(path, FileOpenMode::ReadOnly);
+    reader->createfile();
+
+    atomic<int> received{0};
+    atomic<int> points{0};
+    reader->set_frame_func(Blob, [&received](const char *payload, size_t n) -> bool
+                           {
+                               assert(n == SIZE);
+                               assert(string(payload, n) == make_blob(received.load(), n));
+                               received++;
+                               return true;
+                           });
+    reader->set_msg_func<PointMsg>(Point, [&points](PointMsg msg) -> bool
+                                   {
+                                       assert(msg.x == points.load());
+                                       points++;
+                                       return true;
+                                   });
+    listener.add_fd(reader);
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    // 大帧与小帧交替
+    FramedPipe writer(path, FileOpenMode::WriteOnly);
+    writer.openfile();
+    for (int i = 0; i < N; i++)
+    {
+        string blob = make_blob(i, SIZE);
+        assert(writer.send_frame(Blob, blob.data(), blob.size()));
+        assert(writer.send_frame(Point, PointMsg{i, 0}));
+    }
+    while (received.load() != N || points.load() != N)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    writer.closefile();
+    cout << name << " frame large success" << endl;
+}
+
+int main()
+{
+    test_partial();
+    test_send_timeout();
+
+    FilesListenerEpoll listener(false);
+    test_large(listener, "epoll_sync");
+
+    FilesListenerEpoll pool_listener(true);
+    test_large(pool_listener, "epoll");
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
@@ -0,0 +1,129 @@
+#include "src/mux/FilesListenerEpoll.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// 比较阻塞等待与忙等模式下，每条消息从写入管道到处理函数开始执行的延迟
+// 消息之间间隔一段时间，让阻塞模式下的事件循环与工作线程每次都进入睡眠
+
+const int MSG_NUM = 5000;
+const int INTERVAL_US = 200;
+const int SPIN_US = 500;
+
+struct LatencyMsg
+{
+    long long sent_ns;
+};
+
+long long now_ns()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LatencyPipe : public ReadOnlyFIFO<LatencyMsg>
+{
+public:
+    vector<long long> latencies;
+    atomic<int> received{0};
+
+    LatencyPipe(const string &path) : ReadOnlyFIFO<LatencyMsg>(path)
+    {
+        latencies.reserve(MSG_NUM);
+        auto handler = [this](LatencyMsg msg) -> bool
+        {
+            latencies.push_back(now_ns() - msg.sent_ns);
+            received++;
+            return true;
+        };
+        this->set_process_func(handler);
+    }
+};
+
+// 按2的幂划分的延迟直方图（微秒）与分位数
+void print_histogram(const string &name, vector<long long> latencies)
+{
+    sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p)
+    { return latencies[min<size_t>(latencies.size() - 1, latencies.size() * p)] / 1000.0; };
+
+    cout << name << ": p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+         << " us, p99.9 " << percentile(0.999) << " us, max " << latencies.back() / 1000.0 << " us" << endl;
+
+    const int BUCKETS = 12;
+    vector<int> count(BUCKETS, 0);
+    for (long long ns : latencies)
+    {
+        int b = 0;
+        while (b < BUCKETS - 1 && ns >= (1000LL << b))
+            b++;
+        count[b]++;
+    }
+    for (int b = 0; b < BUCKETS; b++)
+    {
+        if (count[b] == 0)
+            continue;
+        string range = (b == BUCKETS - 1) ? ">=" + to_string(1 << (b - 1)) : "<" + to_string(1 << b);
+        cout << "  " << range << " us\t" << count[b] << "\t" << string(count[b] * 50 / latencies.size(), '#') << endl;
+    }
+}
+
+// 在后台监听一个管道，按固定间隔写入消息并记录延迟
+void bench(FilesListenerEpoll &listener, const string &name)
+{
+    string path = "/tmp/fifo_framework_latency_" + name;
+    auto pipe = make_shared<LatencyPipe>(path);
+    pipe->createfile();
+    listener.add_fd(pipe);
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    WriteOnlyFIFO<LatencyMsg> writer(path);
+    writer.openfile();
+    for (int i = 0; i < MSG_NUM; i++)
+    {
+        // 等上一条处理完，避免消息堆积
+        while (pipe->received.load() != i)
+            this_thread::yield();
+        this_thread::sleep_for(chrono::microseconds(INTERVAL_US));
+
+        LatencyMsg msg;
+        msg.sent_ns = now_ns();
+        writer.send_msg(msg);
+    }
+    while (pipe->received.load() != MSG_NUM)
+        this_thread::yield();
+
+    print_histogram(name, pipe->latencies);
+}
+
+int main()
+{
+    cout << MSG_NUM << " messages, " << INTERVAL_US << " us apart, spin " << SPIN_US << " us, "
+         << thread::hardware_concurrency() << " cpus" << endl;
+
+    FilesListenerEpoll blocking(false);
+    bench(blocking, "loop blocking");
+
+    FilesListenerEpoll busy(false);
+    busy.set_busy_poll_us(SPIN_US);
+    bench(busy, "loop busy-poll");
+
+    ThreadPool blocking_pool(1);
+    FilesListenerEpoll pool_blocking(true, &blocking_pool);
+    bench(pool_blocking, "pool blocking");
+
+    ThreadPool busy_pool(1, ThreadPoolMode::SharedQueue, 1024, SPIN_US);
+    FilesListenerEpoll pool_busy(true, &busy_pool);
+    pool_busy.set_busy_poll_us(SPIN_US);
+    bench(pool_busy, "pool busy-poll");
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
@@ -0,0 +1,347 @@
+#include "src/mux/FilesListenerEpoll.h"
+#include "src/mux/FilesListenerSelect.h"
+#include "src/mux/FilesListenerUring.h"
+#include "src/mux/FilesListenerMulti.h"
+
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include <dirent.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+// 运行时的监听方式由app.conf决定（thread_num、thread_pool_mode、epoll_oneshot、epoll_edge_triggered等）
+
+struct TestMsg
+{
+    int seq;
+};
+
+// 测试用管道，检查消息全部按顺序收到，且同一个管道的回调不会并发
+class TestPipe : public ReadOnlyFIFO<TestMsg>
+{
+public:
+    atomic<int> received{0};
+    atomic<int> running{0};
+    int next_seq = 0;
+
+    TestPipe(const string &path) : ReadOnlyFIFO<TestMsg>(path)
+    {
+        auto handler = [this](TestMsg msg) -> bool
+        {
+            assert(running.fetch_add(1) == 0);
+            assert(msg.seq == next_seq);
+            next_seq++;
+            running--;
+            received++;
+            return true;
+        };
+        this->set_process_func(handler);
+    }
+};
+
+// 向管道写入n条消息
+void send_msgs(const string &path, int n)
+{
+    WriteOnlyFIFO<TestMsg> writer(path);
+    writer.openfile();
+    for (int i = 0; i < n; i++)
+    {
+        TestMsg msg;
+        msg.seq = i;
+        writer.send_msg(msg);
+    }
+    writer.closefile();
+}
+
+// 监听两个管道，等待全部消息处理完
+void test_listener(FilesListener &listener, const string &name, int n)
+{
+    vector<shared_ptr<TestPipe>> pipes;
+    for (int i = 0; i < 2; i++)
+    {
+        auto pipe = make_shared<TestPipe>("/tmp/fifo_framework_" + name + to_string(i));
+        pipe->createfile();
+        listener.add_fd(pipe);
+        pipes.push_back(pipe);
+    }
+
+    // listen()不会返回，放在后台线程中
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    for (auto &pipe : pipes)
+        send_msgs("/tmp/fifo_framework_" + name + to_string(&pipe - &pipes[0]), n);
+
+    for (auto &pipe : pipes)
+        while (pipe->received.load() != n)
+            this_thread::sleep_for(chrono::milliseconds(1));
+
+    cout << name << " listener success" << endl;
+}
+
+// 多个线程post()任务，检查全部在同一个线程（事件循环）中执行
+// 再通过post()在循环中添加一个文件，检查能收到消息
+void test_post(FilesListener &listener, const string &name, int n)
+{
+    atomic<int> done{0};
+    thread::id loop_thread;
+    bool same_thread = true;
+    vector<thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&]()
+                             {
+                                 for (int i = 0; i < n; i++)
+                                     listener.post([&]()
+                                                   {
+                                                       if (done.load() == 0)
+                                                           loop_thread = this_thread::get_id();
+                                                       else if (loop_thread != this_thread::get_id())
+                                                           same_thread = false;
+                                                       done++;
+                                                   });
+                             });
+    for (auto &t : threads)
+        t.join();
+    while (done.load() != 4 * n)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    assert(same_thread);
+
+    string path = "/tmp/fifo_framework_" + name + "_posted";
+    auto pipe = make_shared<TestPipe>(path);
+    pipe->createfile();
+    atomic<bool> added{false};
+    listener.post([&listener, &added, pipe]()
+                  {
+                      listener.add_fd(pipe);
+                      added = true;
+                  });
+    while (!added.load())
+        this_thread::sleep_for(chrono::milliseconds(1));
+    send_msgs(path, n);
+    while (pipe->received.load() != n)
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    cout << name << " post success" << endl;
+}
+
+// 处理函数等待release后才返回的管道
+class BlockingPipe : public ReadOnlyFIFO<TestMsg>
+{
+public:
+    atomic<int> entered{0};
+    atomic<bool> release{false};
+
+    BlockingPipe(const string &path) : ReadOnlyFIFO<TestMsg>(path)
+    {
+        auto handler = [this](TestMsg msg) -> bool
+        {
+            entered++;
+            while (!release.load())
+                this_thread::sleep_for(chrono::milliseconds(1));
+            return true;
+        };
+        this->set_process_func(handler);
+    }
+};
+
+// 从/proc/self/fdinfo中找出fd在epoll中注册的事件，没有注册返回-1
+long epoll_events_of(int fd)
+{
+    DIR *dir = opendir("/proc/self/fd");
+    long events = -1;
+    struct dirent *ent;
+    while (events == -1 && (ent = readdir(dir)) != NULL)
+    {
+        char link[64] = {0};
+        string path = string("/proc/self/fd/") + ent->d_name;
+        if (readlink(path.c_str(), link, sizeof(link) - 1) <= 0 || string(link) != "anon_inode:[eventpoll]")
+            continue;
+
+        ifstream info(string("/proc/self/fdinfo/") + ent->d_name);
+        string line;
+        while (getline(info, line))
+        {
+            istringstream in(line);
+            string key, events_key;
+            int tfd;
+            if (in >> key >> tfd >> events_key >> hex >> events && key == "tfd:" && tfd == fd)
+                break;
+            events = -1;
+        }
+    }
+    closedir(dir);
+    return events;
+}
+
+// 旧文件的回调在删除之后才结束，fd已经被新文件重用，旧回调的rearm不能重新启用新文件
+void test_late_rearm(FilesListenerEpoll &listener)
+{
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    string old_path = "/tmp/fifo_framework_late_old";
+    auto old_pipe = make_shared<BlockingPipe>(old_path);
+    old_pipe->createfile();
+    listener.add_fd(old_pipe);
+    int fd = old_pipe->get_fd();
+    send_msgs(old_path, 1);
+    while (old_pipe->entered.load() == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    // 回调执行期间持有文件的锁，closefile()会等待回调，直接关闭fd让新文件重用
+    assert(listener.remove_fd(old_pipe));
+    close(fd);
+
+    string new_path = "/tmp/fifo_framework_late_new";
+    auto new_pipe = make_shared<BlockingPipe>(new_path);
+    new_pipe->createfile();
+    listener.add_fd(new_pipe);
+    assert(new_pipe->get_fd() == fd);
+    send_msgs(new_path, 1);
+    while (new_pipe->entered.load() == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    assert((epoll_events_of(fd) & EPOLLIN) == 0);
+
+    // 旧回调结束，新文件的回调仍在执行，fd不能被重新启用
+    old_pipe->release = true;
+    this_thread::sleep_for(chrono::milliseconds(50));
+    assert((epoll_events_of(fd) & EPOLLIN) == 0);
+
+    new_pipe->release = true;
+    while ((epoll_events_of(fd) & EPOLLIN) == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    listener.remove_fd(new_pipe);
+    cout << "epoll late rearm success" << endl;
+}
+
+// 进程打开的fd数
+int open_fd_count()
+{
+    int count = 0;
+    for (int fd = 0; fd < 4096; fd++)
+        if (UtilFile::is_valid_fd(fd))
+            count++;
+    return count;
+}
+
+int main()
+{
+    // 不要超过管道容量，写端是非阻塞的
+    int n = 200;
+
+    FilesListenerEpoll epoll_listener(true);
+    test_listener(epoll_listener, "epoll", n);
+
+    // 一次性触发、每次就绪只读一次时，fd在回调期间保持禁用，可以检查迟到的rearm
+    unique_ptr<FilesListenerEpoll> late_listener;
+    if (config::get("epoll_oneshot", "true") == "true" && config::get("epoll_edge_triggered", "false") != "true")
+    {
+        late_listener.reset(new FilesListenerEpoll(true));
+        test_late_rearm(*late_listener);
+    }
+
+    FilesListenerEpoll epoll_sync_listener(false);
+    test_listener(epoll_sync_listener, "epoll_sync", n);
+    test_post(epoll_sync_listener, "epoll_sync", n);
+
+    FilesListenerSelect select_listener(false);
+    test_listener(select_listener, "select", n);
+    test_post(select_listener, "select", n);
+
+    // 多个循环的监听器自己不创建eventfd与timerfd，每个循环一个epoll、eventfd与timerfd
+    int fds_before = open_fd_count();
+    FilesListenerMulti multi_listener(true, 2);
+    assert(open_fd_count() - fds_before == 2 * 3);
+    assert(!multi_listener.set_cpu(2, 0));
+    test_listener(multi_listener, "multi", n);
+    test_post(multi_listener, "multi", n);
+
+    // 循环运行中从其他线程添加、删除文件，分别固定到两个循环
+    FilesListenerMulti pinned_listener(false, 2);
+    thread([&pinned_listener]()
+           { pinned_listener.listen(); })
+        .detach();
+    for (int i = 0; i < 2; i++)
+    {
+        string path = "/tmp/fifo_framework_pinned" + to_string(i);
+        auto pipe = make_shared<TestPipe>(path);
+        pipe->createfile();
+        assert(pinned_listener.add_fd(pipe, i));
+        send_msgs(path, n);
+        while (pipe->received.load() != n)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        assert(pinned_listener.remove_fd(pipe));
+        assert(!pinned_listener.remove_fd(pipe));
+    }
+    cout << "pinned listener success" << endl;
+
+    // 内核支持时测试io_uring，监听线程不会退出，监听器不能在作用域结束时析构
+    unique_ptr<FilesListenerUring> uring_listener, uring_sync_listener;
+    if (FilesListenerUring::supported())
+    {
+        uring_listener.reset(new FilesListenerUring(true));
+        test_listener(*uring_listener, "uring", n);
+
+        uring_sync_listener.reset(new FilesListenerUring(false));
+        test_listener(*uring_sync_listener, "uring_sync", n);
+        test_post(*uring_sync_listener, "uring_sync", n);
+
+        // 通过ring写出
+        auto pipe = make_shared<TestPipe>("/tmp/fifo_framework_uring_write");
+        pipe->createfile();
+        uring_sync_listener->add_fd(pipe);
+        for (int i = 0; i < n; i++)
+        {
+            TestMsg msg;
+            msg.seq = i;
+            uring_sync_listener->write_async(pipe, &msg, sizeof(msg));
+        }
+        while (pipe->received.load() != n)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        cout << "uring write success" << endl;
+
+        // 消息被拆成两次写入，读请求只读到一部分时保留已读的字节，下次补全
+        auto partial = make_shared<TestPipe>("/tmp/fifo_framework_uring_partial");
+        partial->createfile();
+        uring_sync_listener->add_fd(partial);
+        WriteOnlyFIFO<TestMsg> writer("/tmp/fifo_framework_uring_partial");
+        writer.openfile();
+        for (int i = 0; i < 3; i++)
+        {
+            TestMsg msg;
+            msg.seq = i;
+            const char *bytes = (const char *)&msg;
+            assert(write(writer.get_fd(), bytes, 1) == 1);
+            this_thread::sleep_for(chrono::milliseconds(20));
+            assert(write(writer.get_fd(), bytes + 1, sizeof(msg) - 1) == sizeof(msg) - 1);
+        }
+        while (partial->received.load() != 3)
+            this_thread::sleep_for(chrono::milliseconds(1));
+        writer.closefile();
+        cout << "uring partial record success" << endl;
+    }
+
+    // fd超过FD_SETSIZE时select监听器改用poll
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_max >= FD_SETSIZE + 64)
+    {
+        limit.rlim_cur = max<rlim_t>(limit.rlim_cur, FD_SETSIZE + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+        while (dup(0) < FD_SETSIZE)
+            ;
+        FilesListenerSelect poll_listener(false);
+        test_listener(poll_listener, "select_big_fd", n);
+        test_post(poll_listener, "select_big_fd", n);
+    }
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
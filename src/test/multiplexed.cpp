@@ -0,0 +1,220 @@
+#include "src/fd/MultiplexedPipe.h"
+
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+enum TestType
+{
+    Small,
+    Big,
+    Unused,
+    Text,
+};
+
+// 不同长度的消息，都以协议类型开头
+struct SmallMsg
+{
+    TestType protocal_type = TestType::Small;
+    int value;
+};
+
+struct BigMsg
+{
+    TestType protocal_type = TestType::Big;
+    int value;
+    char data[500];
+};
+
+struct TextMsg
+{
+    TestType protocal_type = TestType::Text;
+    char text[64];
+};
+
+typedef MultiplexedPipe<SmallMsg, BigMsg, TextMsg> TestPipe;
+
+const string PATH = "/tmp/fifo_framework_multiplexed";
+
+SmallMsg make_small(int i)
+{
+    SmallMsg msg;
+    msg.value = i;
+    return msg;
+}
+
+BigMsg make_big(int i)
+{
+    BigMsg msg;
+    msg.value = i;
+    memset(msg.data, i, sizeof(msg.data));
+    return msg;
+}
+
+// 不同类型的消息交错发送，每种类型按顺序到达自己的处理函数
+void test_dispatch(TestPipe &reader, TestPipe &writer)
+{
+    const int N = 100;
+    int smalls = 0, bigs = 0, texts = 0;
+    reader.set_process_func<SmallMsg>([&smalls](SmallMsg msg) -> bool
+                                      {
+                                          assert(msg.value == smalls++);
+                                          return true;
+                                      });
+    reader.set_process_func<BigMsg>([&bigs](BigMsg msg) -> bool
+                                    {
+                                        assert(msg.value == bigs);
+                                        assert(msg.data[0] == (char)bigs && msg.data[sizeof(msg.data) - 1] == (char)bigs);
+                                        bigs++;
+                                        return true;
+                                    });
+    reader.set_process_func<TextMsg>([&texts](TextMsg msg) -> bool
+                                     {
+                                         assert(string(msg.text) == "hello " + to_string(texts++));
+                                         return true;
+                                     });
+
+    int reads = 0;
+    for (int i = 0; i < N; i++)
+    {
+        assert(writer.send_msg(make_small(i)));
+        assert(writer.send_msg(make_big(i)));
+        TextMsg text;
+        strcpy(text.text, ("hello " + to_string(i)).c_str());
+        assert(writer.send_msg(text));
+        // 管道容量有限，每隔几条读一次
+        if (i % 8 == 7)
+            while (reader.recv_and_process() > 0)
+                reads++;
+    }
+    while (reader.recv_and_process() > 0)
+        reads++;
+    assert(smalls == N && bigs == N && texts == N);
+    // 一次读取处理多条消息
+    assert(reads < 3 * N);
+    cout << "multiplexed dispatch success, " << 3 * N << " msgs in " << reads << " reads" << endl;
+}
+
+// 消息被拆成多次写入时，不完整的部分留到下次读取补全；同类型的多条消息一次发送
+void test_partial(TestPipe &reader, TestPipe &writer)
+{
+    int bigs = 0;
+    reader.set_process_func<BigMsg>([&bigs](BigMsg msg) -> bool
+                                    {
+                                        assert(msg.value == bigs++);
+                                        return true;
+                                    });
+
+    BigMsg msgs[2] = {make_big(0), make_big(1)};
+    const char *bytes = (const char *)msgs;
+    size_t cuts[] = {2, sizeof(BigMsg) + 10, sizeof(msgs)};
+    size_t begin = 0;
+    for (size_t cut : cuts)
+    {
+        assert(write(writer.get_fd(), bytes + begin, cut - begin) == (int)(cut - begin));
+        begin = cut;
+        assert(reader.recv_and_process() > 0);
+    }
+    assert(bigs == 2);
+
+    vector<BigMsg> many;
+    for (int i = 2; i < 10; i++)
+        many.push_back(make_big(i));
+    assert(writer.send_many(many));
+    while (reader.recv_and_process() > 0)
+        ;
+    assert(bigs == 10);
+    cout << "multiplexed partial success" << endl;
+}
+
+// 未知的协议类型丢弃缓冲区中已读到的数据，同一次读取中之后的消息也被丢弃，之后的写入正常处理
+void test_unknown(TestPipe &reader, TestPipe &writer)
+{
+    int smalls = 0;
+    reader.set_process_func<SmallMsg>([&smalls](SmallMsg msg) -> bool
+                                      {
+                                          assert(msg.value == smalls + 1);
+                                          smalls++;
+                                          return true;
+                                      });
+
+    // 坏消息后面的消息在同一次读取中，不会从坏消息的中间错位对齐
+    SmallMsg bad = make_small(0);
+    bad.protocal_type = TestType::Unused;
+    assert(write(writer.get_fd(), &bad, sizeof(bad)) == sizeof(bad));
+    assert(writer.send_msg(make_small(-1)));
+    while (reader.recv_and_process() > 0)
+        ;
+    assert(smalls == 0);
+
+    assert(writer.send_msg(make_small(1)));
+    assert(writer.send_msg(make_small(2)));
+    while (reader.recv_and_process() > 0)
+        ;
+    assert(smalls == 2);
+    cout << "multiplexed unknown type success" << endl;
+}
+
+// 逐个字段读取（先读协议类型再读剩下的部分）与一次读取多条的速度
+void bench(TestPipe &reader, TestPipe &writer)
+{
+    const int N = 200000, CHUNK = 64;
+    long long received = 0;
+    reader.set_process_func<SmallMsg>([&received](SmallMsg msg) -> bool
+                                      {
+                                          received++;
+                                          return true;
+                                      });
+    vector<SmallMsg> msgs(CHUNK, make_small(0));
+
+    double seconds = 0;
+    for (int i = 0; i < N; i += CHUNK)
+    {
+        writer.send_many(msgs);
+        auto start = chrono::steady_clock::now();
+        for (int j = 0; j < CHUNK; j++)
+        {
+            TestType type;
+            SmallMsg msg;
+            assert(reader.readfile(&type, sizeof(type)) == sizeof(type));
+            assert(type == TestType::Small);
+            assert(reader.readfile((char *)&msg + sizeof(type), sizeof(msg) - sizeof(type)) == sizeof(msg) - sizeof(type));
+            received++;
+        }
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    cout << "read by field: " << received / seconds / 1e6 << " M msgs/s" << endl;
+
+    received = 0;
+    seconds = 0;
+    for (int i = 0; i < N; i += CHUNK)
+    {
+        writer.send_many(msgs);
+        auto start = chrono::steady_clock::now();
+        while (reader.recv_and_process() > 0)
+            ;
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    assert(received == (N + CHUNK - 1) / CHUNK * CHUNK);
+    cout << "multiplexed: " << received / seconds / 1e6 << " M msgs/s" << endl;
+}
+
+int main()
+{
+    TestPipe reader(PATH, FileOpenMode::ReadOnly);
+    reader.createfile();
+    reader.openfile();
+    TestPipe writer(PATH, FileOpenMode::WriteOnly);
+    writer.openfile();
+
+    test_dispatch(reader, writer);
+    test_partial(reader, writer);
+    test_unknown(reader, writer);
+    bench(reader, writer);
+
+    writer.closefile();
+    reader.closefile();
+    reader.deletefile();
+}
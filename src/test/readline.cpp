@@ -0,0 +1,105 @@
+#include "src/fd/NamedPipe.h"
+
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 写端以原始字节写入，读端按行读取
+class LinePipe : public NamedPipe<int, int>
+{
+public:
+    LinePipe(const string &path) : NamedPipe<int, int>(path, FileOpenMode::ReadAndWrite) {}
+    void recv_callback() {}
+    void write_raw(const string &s) { assert(writefile((void *)s.data(), s.size()) == (int)s.size()); }
+};
+
+// 行被分成多次写入、一次写入多行、一行超过缓冲区
+void test_readline(LinePipe &pipe)
+{
+    // 非阻塞文件没有完整的一行时返回空，已读到的部分保留
+    pipe.write_raw("ab");
+    assert(pipe.readline().empty());
+    pipe.write_raw("c\nd");
+    assert(pipe.readline() == "abc\n");
+    pipe.write_raw("ef\nghi\n");
+    assert(pipe.readline() == "def\n");
+    assert(pipe.readline() == "ghi\n");
+    assert(pipe.readline().empty());
+
+    string long_line(10000, 'x');
+    long_line += '\n';
+    for (size_t i = 0; i < long_line.size(); i += 3000)
+    {
+        pipe.write_raw(long_line.substr(i, 3000));
+        string line = pipe.readline();
+        assert(line.empty() == (i + 3000 < long_line.size()));
+        if (!line.empty())
+            assert(line == long_line);
+    }
+    cout << "readline success" << endl;
+}
+
+// 一次读取的所有完整行都交给回调，不完整的留到下一次
+void test_readlines(LinePipe &pipe)
+{
+    vector<string> lines;
+    auto collect = [&lines](const char *line, size_t n)
+    { lines.push_back(string(line, n)); };
+
+    pipe.write_raw("1\n22\n333\n44");
+    assert(pipe.readlines(collect) == 3);
+    assert(lines.size() == 3 && lines[0] == "1\n" && lines[1] == "22\n" && lines[2] == "333\n");
+    assert(pipe.readlines(collect) == 0);
+
+    pipe.write_raw("4\n");
+    assert(pipe.readlines(collect) == 1);
+    assert(lines.back() == "444\n");
+
+    // 先用readline取走一行，剩下的行不需要再读文件
+    pipe.write_raw("5\n6\n7\n");
+    assert(pipe.readline() == "5\n");
+    assert(pipe.readlines(collect) == 2);
+    assert(lines.back() == "7\n");
+    cout << "readlines success" << endl;
+}
+
+// 大量短行的读取速度
+void bench_readlines(LinePipe &pipe)
+{
+    const int N = 1000000;
+    const string line = "send alice hello world\n";
+    string chunk;
+    for (int i = 0; i < 1000; i++)
+        chunk += line;
+
+    int lines = 0;
+    size_t bytes = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < N / 1000; i++)
+    {
+        pipe.write_raw(chunk);
+        while (lines < (i + 1) * 1000)
+            lines += pipe.readlines([&bytes](const char *line, size_t n)
+                                    { bytes += n; });
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    assert(lines == N && bytes == N * line.size());
+    cout << "readlines: " << N / seconds / 1e6 << " M lines/s" << endl;
+}
+
+int main()
+{
+    string path = "/tmp/fifo_framework_readline";
+    LinePipe pipe(path);
+    pipe.createfile();
+    pipe.openfile();
+
+    test_readline(pipe);
+    test_readlines(pipe);
+    bench_readlines(pipe);
+
+    pipe.closefile();
+    pipe.deletefile();
+}
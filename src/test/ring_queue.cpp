@@ -0,0 +1,108 @@
+#include "src/ThreadPool/ThreadPool.hpp"
+#include "src/ThreadPool/RingQueue.hpp"
+
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 每个生产者写入的元素个数
+const int ITEMS_PER_PRODUCER = 200000;
+
+// 功能测试：满时返回false，先进先出
+void test_ring_queue()
+{
+    RingQueue<int> q(4);
+    assert(q.capacity() == 4);
+    for (int i = 0; i < 4; i++)
+        assert(q.push(i));
+    int x = 100;
+    assert(!q.push(x));
+
+    for (int i = 0; i < 4; i++)
+    {
+        assert(q.pop(x));
+        assert(x == i);
+    }
+    assert(!q.pop(x));
+    assert(q.empty());
+    cout << "ring queue success" << endl;
+}
+
+// 多生产者多消费者压测，返回耗时（毫秒）
+template <typename Queue>
+double bench(Queue &q, int producers, int consumers)
+{
+    long long total = (long long)producers * ITEMS_PER_PRODUCER;
+    atomic<long long> consumed(0), sum(0);
+    vector<thread> threads;
+
+    auto start = chrono::steady_clock::now();
+
+    for (int p = 0; p < producers; p++)
+        threads.emplace_back([&q]()
+                             {
+                                 for (int i = 0; i < ITEMS_PER_PRODUCER; i++)
+                                 {
+                                     int x = i;
+                                     // 有界队列满时让出CPU
+                                     while (!q.push(x))
+                                         this_thread::yield();
+                                 } });
+
+    for (int c = 0; c < consumers; c++)
+        threads.emplace_back([&q, &consumed, &sum, total]()
+                             {
+                                 int x;
+                                 while (consumed.load() < total)
+                                 {
+                                     if (q.pop(x))
+                                     {
+                                         sum += x;
+                                         consumed++;
+                                     }
+                                     else
+                                         this_thread::yield();
+                                 } });
+
+    for (auto &t : threads)
+        t.join();
+
+    auto end = chrono::steady_clock::now();
+    long long expect = (long long)producers * ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER - 1) / 2;
+    assert(sum.load() == expect);
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+// AtomicQueue的push总是成功，包一层与RingQueue接口一致
+struct AtomicQueueAdapter
+{
+    AtomicQueue<int> q;
+    bool push(int &x)
+    {
+        q.push(x);
+        return true;
+    }
+    bool pop(int &x) { return q.pop(x); }
+};
+
+void bench_contention()
+{
+    int configs[][2] = {{1, 1}, {2, 2}, {4, 4}, {8, 8}};
+    for (auto &c : configs)
+    {
+        AtomicQueueAdapter atomic_queue;
+        RingQueue<int> ring_queue(1024);
+        double t1 = bench(atomic_queue, c[0], c[1]);
+        double t2 = bench(ring_queue, c[0], c[1]);
+        cout << c[0] << " producers / " << c[1] << " consumers: "
+             << "AtomicQueue " << t1 << " ms, RingQueue " << t2 << " ms" << endl;
+    }
+}
+
+int main()
+{
+    test_ring_queue();
+    bench_contention();
+}
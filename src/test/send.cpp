@@ -0,0 +1,143 @@
+#include "src/fd/NamedPipe.h"
+
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 每条消息带写端编号、序号与校验，检查消息没有被拆开或交错
+struct Record
+{
+    int writer;
+    int seq;
+    char data[56];
+};
+
+Record make_record(int writer, int seq)
+{
+    Record r;
+    r.writer = writer;
+    r.seq = seq;
+    memset(r.data, 'a' + (writer * 7 + seq) % 26, sizeof(r.data));
+    return r;
+}
+
+void check_record(const Record &r)
+{
+    for (char c : r.data)
+        assert(c == 'a' + (r.writer * 7 + r.seq) % 26);
+}
+
+// 读出n条消息，检查每个写端的消息按顺序到达
+void read_records(ReadOnlyFIFO<Record> &reader, int n, int writers)
+{
+    vector<int> next(writers, 0);
+    for (int i = 0; i < n; i++)
+    {
+        Record r;
+        assert(reader.recv_msg(r));
+        check_record(r);
+        assert(r.seq == next[r.writer]++);
+    }
+    Record r;
+    assert(!reader.recv_msg(r));
+}
+
+// 多个线程同时批量发送到同一个管道
+void test_send_many(const string &path, ReadOnlyFIFO<Record> &reader)
+{
+    const int WRITERS = 4, N = 200;
+    vector<thread> threads;
+    for (int w = 0; w < WRITERS; w++)
+        threads.emplace_back([&path, w]()
+                             {
+                                 WriteOnlyFIFO<Record> writer(path);
+                                 writer.openfile();
+                                 vector<Record> records;
+                                 for (int i = 0; i < N; i++)
+                                     records.push_back(make_record(w, i));
+                                 assert(writer.send_many(records));
+                                 writer.closefile();
+                             });
+    for (auto &t : threads)
+        t.join();
+
+    read_records(reader, WRITERS * N, WRITERS);
+    cout << "send_many success" << endl;
+}
+
+// 不连续的记录通过iovec一起发送
+void test_send_iov(const string &path, ReadOnlyFIFO<Record> &reader)
+{
+    const int N = 300;
+    vector<Record> records;
+    for (int i = N - 1; i >= 0; i--)
+        records.push_back(make_record(0, i));
+
+    // 倒序存放，按序号顺序发送
+    vector<struct iovec> iov;
+    for (int i = N - 1; i >= 0; i--)
+    {
+        struct iovec v;
+        v.iov_base = &records[i];
+        v.iov_len = sizeof(Record);
+        iov.push_back(v);
+    }
+
+    WriteOnlyFIFO<Record> writer(path);
+    writer.openfile();
+    assert(writer.send_iov(iov.data(), iov.size()));
+    writer.closefile();
+
+    read_records(reader, N, 1);
+    cout << "send_iov success" << endl;
+}
+
+// 逐条发送与批量发送的速度
+void bench(const string &path, ReadOnlyFIFO<Record> &reader)
+{
+    const int ROUNDS = 2000, N = 500;
+    WriteOnlyFIFO<Record> writer(path);
+    writer.openfile();
+    vector<Record> records;
+    for (int i = 0; i < N; i++)
+        records.push_back(make_record(0, i));
+
+    for (int batch = 0; batch < 2; batch++)
+    {
+        // 只统计发送的时间，每轮发送后读空管道
+        double seconds = 0;
+        for (int round = 0; round < ROUNDS; round++)
+        {
+            auto start = chrono::steady_clock::now();
+            if (batch)
+                writer.send_many(records);
+            else
+                for (auto &r : records)
+                    writer.send_msg(r);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            Record r;
+            for (int i = 0; i < N; i++)
+                reader.recv_msg(r);
+        }
+        cout << (batch ? "send_many: " : "send_msg: ") << ROUNDS * N / seconds / 1e6 << " M msgs/s" << endl;
+    }
+    writer.closefile();
+}
+
+int main()
+{
+    string path = "/tmp/fifo_framework_send";
+    ReadOnlyFIFO<Record> reader(path);
+    reader.createfile();
+    reader.openfile();
+
+    test_send_many(path, reader);
+    test_send_iov(path, reader);
+    bench(path, reader);
+
+    reader.closefile();
+    reader.deletefile();
+}
@@ -0,0 +1,200 @@
+#include "src/fd/SeqPacketSocket.h"
+#include "src/mux/FilesListenerEpoll.h"
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+// 运行时的监听方式由app.conf决定（比如epoll_edge_triggered）
+
+struct Request
+{
+    int client;
+    int value;
+};
+
+struct Reply
+{
+    int client;
+    int value;
+};
+
+// 比PIPE_BUF大得多的消息
+struct BigMsg
+{
+    int value;
+    char data[100000];
+};
+
+typedef SeqPacketListener<Request, Reply> EchoServer;
+typedef SeqPacketConnection<Reply, Request> EchoClient;
+
+// 等待连接可读
+void wait_readable(int fd)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    assert(poll(&p, 1, 5000) == 1);
+}
+
+// 多个客户端同时请求，每个客户端按顺序收到自己的回复；客户端关闭后服务端删除连接
+void test_echo(FilesListener &listener, const string &name)
+{
+    const int CLIENTS = 20, N = 200, WINDOW = 8;
+    string path = "/tmp/fifo_framework_seqpacket_" + name;
+    auto server = make_shared<EchoServer>(path, &listener);
+    server->createfile();
+
+    atomic<int> accepted{0}, closed{0};
+    server->set_process_func([](shared_ptr<EchoServer::Connection> conn, Request req) -> bool
+                             {
+                                 Reply reply;
+                                 reply.client = req.client;
+                                 reply.value = req.value + 1;
+                                 return conn->send_msg(reply);
+                             });
+    server->set_accept_func([&accepted](shared_ptr<EchoServer::Connection> conn)
+                            { accepted++; });
+    server->set_close_func([&closed](shared_ptr<EchoServer::Connection> conn)
+                           { closed++; });
+    listener.add_fd(server);
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    vector<thread> clients;
+    for (int c = 0; c < CLIENTS; c++)
+        clients.emplace_back([&path, c]()
+                             {
+                                 EchoClient client(path);
+                                 client.openfile();
+                                 // 最多WINDOW个请求等待回复，服务端回复时不会因为客户端不读而阻塞
+                                 Reply reply;
+                                 int replied = 0;
+                                 for (int i = 0; i < N; i++)
+                                 {
+                                     Request req;
+                                     req.client = c;
+                                     req.value = i;
+                                     assert(client.send_msg(req));
+                                     if (i - replied + 1 < WINDOW)
+                                         continue;
+                                     while (!client.recv_msg(reply))
+                                         wait_readable(client.get_fd());
+                                     assert(reply.client == c && reply.value == ++replied);
+                                 }
+                                 while (replied < N)
+                                 {
+                                     while (!client.recv_msg(reply))
+                                         wait_readable(client.get_fd());
+                                     assert(reply.client == c && reply.value == ++replied);
+                                 }
+                                 client.closefile();
+                             });
+    for (auto &t : clients)
+        t.join();
+
+    while (closed.load() != CLIENTS)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    assert(accepted.load() == CLIENTS);
+    server->deletefile();
+    cout << name << " seqpacket echo success" << endl;
+}
+
+// 大消息作为一个数据包完整到达；客户端也可以加入监听器
+// 服务端回复时等待客户端读走，客户端需要在另一个监听器中
+void test_big(FilesListener &listener, FilesListener &client_listener)
+{
+    string path = "/tmp/fifo_framework_seqpacket_big";
+    auto server = make_shared<SeqPacketListener<BigMsg, BigMsg>>(path, &listener);
+    server->createfile();
+    server->set_process_func([](shared_ptr<SeqPacketConnection<BigMsg, BigMsg>> conn, BigMsg msg) -> bool
+                             {
+                                 for (size_t i = 0; i < sizeof(msg.data); i++)
+                                     assert(msg.data[i] == (char)(msg.value + i));
+                                 msg.value++;
+                                 return conn->send_msg(msg);
+                             });
+    listener.add_fd(server);
+
+    const int N = 50;
+    atomic<int> received{0};
+    auto client = make_shared<SeqPacketConnection<BigMsg, BigMsg>>(path);
+    client->set_process_func([&received](BigMsg msg) -> bool
+                             {
+                                 assert(msg.value == received.load() + 1);
+                                 received++;
+                                 return true;
+                             });
+    client->watch(&client_listener);
+
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+    thread([&client_listener]()
+           { client_listener.listen(); })
+        .detach();
+
+    auto msg = make_shared<BigMsg>();
+    for (int i = 0; i < N; i++)
+    {
+        msg->value = i;
+        for (size_t j = 0; j < sizeof(msg->data); j++)
+            msg->data[j] = (char)(i + j);
+        assert(client->send_msg(*msg));
+    }
+    while (received.load() != N)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    server->deletefile();
+    cout << "seqpacket big message success" << endl;
+}
+
+// 对端不读时发送等待超时返回false，不会一直阻塞
+void test_send_timeout()
+{
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, fds) == 0);
+    EchoServer::Connection sender(fds[0], "socketpair");
+    EchoClient peer(fds[1], "socketpair");
+    sender.set_send_timeout(50);
+
+    Reply reply;
+    reply.client = 0;
+    int sent = 0;
+    auto start = chrono::steady_clock::now();
+    while (sender.send_msg(reply))
+        sent++;
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    assert(sent > 0 && elapsed >= 50 && elapsed < 2000);
+
+    // 对端读走后可以继续发送
+    for (int i = 0; i < sent; i++)
+        assert(peer.recv_msg(reply));
+    assert(sender.send_msg(reply));
+    sender.closefile();
+    peer.closefile();
+    cout << "seqpacket send timeout success" << endl;
+}
+
+int main()
+{
+    test_send_timeout();
+
+    FilesListenerEpoll listener(false);
+    test_echo(listener, "epoll_sync");
+
+    FilesListenerEpoll pool_listener(true);
+    test_echo(pool_listener, "epoll");
+
+    FilesListenerEpoll big_listener(false);
+    FilesListenerEpoll client_listener(false);
+    test_big(big_listener, client_listener);
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
@@ -0,0 +1,227 @@
+#include "src/fd/ShmRing.h"
+#include "src/fd/NamedPipe.h"
+#include "src/mux/FilesListenerEpoll.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+#include <sys/wait.h>
+
+using namespace std;
+
+// 与聊天消息大小相近的消息
+struct TestMsg
+{
+    int value;
+    char data[192];
+};
+
+const string PATH = "/tmp/fifo_framework_ring";
+
+TestMsg make_msg(int i)
+{
+    TestMsg msg;
+    msg.value = i;
+    memset(msg.data, i, sizeof(msg.data));
+    return msg;
+}
+
+void check_msg(const TestMsg &msg, int i)
+{
+    assert(msg.value == i);
+    assert(msg.data[0] == (char)i && msg.data[sizeof(msg.data) - 1] == (char)i);
+}
+
+// 队列满时重试
+void send_all(ShmRing<TestMsg> &writer, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        TestMsg msg = make_msg(i);
+        while (!writer.send_msg(msg))
+            this_thread::yield();
+    }
+}
+
+// 不使用监听器：写满、读空、跨过环的末尾
+void test_basic()
+{
+    ShmRing<TestMsg> reader(PATH + "_basic", FileOpenMode::ReadOnly, 8);
+    reader.createfile();
+    reader.openfile();
+    ShmRing<TestMsg> writer(PATH + "_basic", FileOpenMode::WriteOnly);
+    writer.openfile();
+    assert(writer.capacity() == 8);
+
+    TestMsg msg;
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < 8; i++)
+            assert(writer.send_msg(make_msg(round * 8 + i)));
+        assert(!writer.send_msg(make_msg(0)));
+        for (int i = 0; i < 8; i++)
+        {
+            assert(reader.recv_msg(msg));
+            check_msg(msg, round * 8 + i);
+        }
+        assert(!reader.recv_msg(msg));
+    }
+
+    // 批量写入只写入放得下的部分
+    vector<TestMsg> msgs;
+    for (int i = 0; i < 12; i++)
+        msgs.push_back(make_msg(i));
+    assert(writer.send_many(msgs.data(), msgs.size()) == 8);
+
+    writer.closefile();
+    reader.closefile();
+    reader.deletefile();
+    cout << "shm ring basic success" << endl;
+}
+
+// 读端由监听器在门铃响时处理，读端忙碌时写端不敲门铃
+void test_listener()
+{
+    const int N = 200000;
+    auto reader = make_shared<ShmRing<TestMsg>>(PATH + "_listener", FileOpenMode::ReadOnly, 256);
+    reader->createfile();
+
+    atomic<int> received{0};
+    reader->set_batch_process_func([&received](const TestMsg *msgs, size_t n) -> bool
+                                   {
+                                       for (size_t i = 0; i < n; i++)
+                                           check_msg(msgs[i], received.load() + i);
+                                       received += n;
+                                       return true;
+                                   });
+
+    FilesListenerEpoll listener(false);
+    listener.add_fd(reader);
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    ShmRing<TestMsg> writer(PATH + "_listener", FileOpenMode::WriteOnly);
+    writer.openfile();
+    send_all(writer, N);
+    while (received.load() != N)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    assert(writer.doorbells() < N);
+    // 已经映射的两端不受影响
+    reader->deletefile();
+    cout << "shm ring listener success, " << writer.doorbells() << " doorbells for " << N << " msgs" << endl;
+}
+
+// 写端在另一个进程中
+void test_process()
+{
+    const int N = 100000;
+    ShmRing<TestMsg> reader(PATH + "_process", FileOpenMode::ReadOnly, 1024);
+    reader.createfile();
+    reader.openfile();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        ShmRing<TestMsg> writer(PATH + "_process", FileOpenMode::WriteOnly);
+        writer.openfile();
+        send_all(writer, N);
+        _exit(0);
+    }
+
+    TestMsg msg;
+    for (int i = 0; i < N;)
+    {
+        if (!reader.recv_msg(msg))
+        {
+            this_thread::yield();
+            continue;
+        }
+        check_msg(msg, i++);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    reader.closefile();
+    reader.deletefile();
+    cout << "shm ring process success" << endl;
+}
+
+// 通过监听器收消息，共享内存队列与命名管道的速度
+void bench()
+{
+    const int N = 1000000;
+
+    // 共享内存
+    {
+        auto reader = make_shared<ShmRing<TestMsg>>(PATH + "_bench", FileOpenMode::ReadOnly, 4096);
+        reader->createfile();
+        atomic<int> received{0};
+        reader->set_batch_process_func([&received](const TestMsg *msgs, size_t n) -> bool
+                                       {
+                                           received += n;
+                                           return true;
+                                       });
+        auto listener = new FilesListenerEpoll(false);
+        listener->add_fd(reader);
+        thread([listener]()
+               { listener->listen(); })
+            .detach();
+
+        ShmRing<TestMsg> writer(PATH + "_bench", FileOpenMode::WriteOnly);
+        writer.openfile();
+        auto start = chrono::steady_clock::now();
+        send_all(writer, N);
+        while (received.load() != N)
+            this_thread::yield();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "shm ring: " << N / seconds / 1e6 << " M msgs/s, " << writer.doorbells() << " doorbells" << endl;
+        reader->deletefile();
+    }
+
+    // 命名管道
+    {
+        auto reader = make_shared<ReadOnlyFIFO<TestMsg>>(PATH + "_bench_fifo");
+        reader->createfile();
+        atomic<int> received{0};
+        reader->set_batch_process_func([&received](const TestMsg *msgs, size_t n) -> bool
+                                       {
+                                           received += n;
+                                           return true;
+                                       });
+        auto listener = new FilesListenerEpoll(false);
+        listener->add_fd(reader);
+        thread([listener]()
+               { listener->listen(); })
+            .detach();
+
+        WriteOnlyFIFO<TestMsg> writer(PATH + "_bench_fifo");
+        writer.openfile();
+        TestMsg msg = make_msg(0);
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < N; i++)
+            while (write(writer.get_fd(), &msg, sizeof(msg)) != sizeof(msg))
+                this_thread::yield();
+        while (received.load() != N)
+            this_thread::yield();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "FIFO: " << N / seconds / 1e6 << " M msgs/s" << endl;
+        reader->deletefile();
+    }
+}
+
+int main()
+{
+    test_basic();
+    test_process();
+    test_listener();
+    bench();
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
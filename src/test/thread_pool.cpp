@@ -1,5 +1,7 @@
 #include "src/ThreadPool/ThreadPool.hpp"
+#include "src/ThreadPool/Strand.hpp"
 
+#include <cassert>
 #include <iostream>
 
 using namespace std;
@@ -28,7 +30,214 @@ void test()
     pool.shutdown();
 }
 
+// 工作窃取模式，任务中再提交任务会进入工作线程自己的队列
+void test_work_stealing()
+{
+    int num = 4;
+    ThreadPool pool(num, ThreadPoolMode::WorkStealing);
+
+    atomic<int> sum(0);
+    vector<future<void>> v;
+    for (int i = 0; i < 100; i++)
+    {
+        v.push_back(pool.submit([&pool, &sum, i]()
+                                {
+                                    sum += i;
+                                    pool.submit([&sum]() { sum += 1; });
+                                }));
+    }
+    for (auto &f : v)
+        f.wait();
+
+    // 等待任务中提交的任务完成
+    while (sum.load() != 4950 + 100)
+        this_thread::yield();
+
+    cout << "work stealing sum " << sum.load() << endl;
+    pool.shutdown();
+}
+
+// 任务队列容量很小，提交者会被阻塞等待而不是让队列无限增长；try_post()不等待，队列满时返回false
+void test_bounded_queue()
+{
+    ThreadPool pool(2, ThreadPoolMode::SharedQueue, 2);
+
+    vector<future<int>> v;
+    for (int i = 0; i < 100; i++)
+        v.push_back(pool.submit(add, i, 1));
+
+    int sum = 0;
+    for (auto &f : v)
+        sum += f.get();
+
+    cout << "bounded queue sum " << sum << endl;
+    pool.shutdown();
+
+    // 唯一的工作线程被占用时，队列放满后try_post()返回false，任务留给调用者
+    ThreadPool single(1, ThreadPoolMode::SharedQueue, 2);
+    atomic<bool> started{false};
+    atomic<bool> release{false};
+    single.post([&started, &release]()
+                {
+                    started = true;
+                    while (!release.load())
+                        this_thread::yield();
+                });
+    while (!started.load())
+        this_thread::yield();
+    vector<int> order;
+    vector<Task> tasks;
+    for (int i = 0; i < 5; i++)
+        tasks.emplace_back([&order, i]()
+                           { order.push_back(i); });
+    assert(single.try_post_batch(tasks) == 2 && tasks.size() == 3);
+    Task rejected = std::move(tasks[0]);
+    tasks.erase(tasks.begin());
+    assert(!single.try_post(rejected) && rejected);
+    release = true;
+    while (!single.try_post(rejected))
+        this_thread::yield();
+    single.post_batch(tasks);
+    single.submit(add, 0, 0).get();
+    assert(order.size() == 5);
+    for (int i = 0; i < 5; i++)
+        assert(order[i] == i);
+
+    // 工作线程向已满的队列提交时帮忙执行队列中的任务，不会死锁，顺序不变
+    order.clear();
+    single.submit([&single, &order]()
+                  {
+                      for (int i = 0; i < 100; i++)
+                          single.post([&single, &order, i]()
+                                      {
+                                          order.push_back(i);
+                                          single.post([]() {});
+                                      });
+                  })
+        .get();
+    single.submit(add, 0, 0).get();
+    assert(order.size() == 100);
+    for (int i = 0; i < 100; i++)
+        assert(order[i] == i);
+    cout << "bounded queue back-pressure success" << endl;
+    single.shutdown();
+}
+
+// 小的lambda存放在Task内部，大的在堆上
+void test_task()
+{
+    int x = 0;
+    Task small([&x]()
+               { x++; });
+    assert(small.stored_inline());
+    small();
+
+    char big_buf[128] = {1};
+    Task big([&x, big_buf]()
+             { x += big_buf[0]; });
+    assert(!big.stored_inline());
+
+    // 移动后原对象为空
+    Task moved(std::move(big));
+    assert(!big && moved);
+    moved();
+    assert(x == 2);
+
+    ThreadPool pool(2);
+    TaskFuture<int> result;
+    pool.submit_to(result, add, 40, 2);
+    assert(result.get() == 42);
+
+    TaskFuture<void> done;
+    pool.submit_to(done, [&x]()
+                   { x = 100; });
+    done.wait();
+    assert(x == 100);
+
+    cout << "task success" << endl;
+    pool.shutdown();
+}
+
+// 不返回future的任务与批量提交
+void test_post_batch(ThreadPoolMode mode)
+{
+    ThreadPool pool(3, mode);
+    atomic<int> sum(0);
+
+    pool.post([&sum]()
+              { sum += 1; });
+    pool.post(add, 1, 2);
+
+    // 批量提交，完成后vector被清空
+    vector<Task> tasks;
+    for (int i = 0; i < 10; i++)
+        tasks.emplace_back([&sum, i]()
+                           { sum += i; });
+    pool.post_batch(tasks);
+    assert(tasks.empty());
+
+    // 批量提交并取回结果
+    vector<function<int()>> funcs;
+    for (int i = 0; i < 10; i++)
+        funcs.push_back([i]()
+                        { return i * 2; });
+    auto futures = pool.submit_batch(funcs);
+    int total = 0;
+    for (auto &f : futures)
+        total += f.get();
+    assert(total == 90);
+
+    while (sum.load() != 46)
+        this_thread::yield();
+
+    cout << "post batch success" << endl;
+    pool.shutdown();
+}
+
+// 同一个Strand上的任务按顺序执行且不会并发，不同Strand并行
+void test_strand()
+{
+    ThreadPool pool(4);
+    auto a = make_shared<Strand>(&pool);
+    auto b = make_shared<Strand>(&pool);
+
+    const int n = 1000;
+    vector<int> order_a, order_b;
+    atomic<int> running_a(0), done(0);
+
+    for (int i = 0; i < n; i++)
+    {
+        a->post([&, i]()
+                {
+                    assert(running_a.fetch_add(1) == 0);
+                    order_a.push_back(i);
+                    running_a--;
+                    done++;
+                });
+        b->post([&, i]()
+                {
+                    order_b.push_back(i);
+                    done++;
+                });
+    }
+
+    while (done.load() != 2 * n)
+        this_thread::yield();
+
+    for (int i = 0; i < n; i++)
+        assert(order_a[i] == i && order_b[i] == i);
+
+    cout << "strand success" << endl;
+    pool.shutdown();
+}
+
 int main()
 {
     test();
+    test_work_stealing();
+    test_bounded_queue();
+    test_task();
+    test_post_batch(ThreadPoolMode::SharedQueue);
+    test_post_batch(ThreadPoolMode::WorkStealing);
+    test_strand();
 }
\ No newline at end of file
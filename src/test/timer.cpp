@@ -0,0 +1,159 @@
+#include "src/mux/TimerWheel.h"
+#include "src/mux/FilesListenerEpoll.h"
+#include "src/mux/FilesListenerSelect.h"
+#include "src/mux/FilesListenerUring.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cassert>
+#include <iostream>
+
+#include <poll.h>
+
+using namespace std;
+
+uint64_t now_ms()
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 没有监听器，直接等待timerfd驱动时间轮，返回timerfd触发的次数
+int drive(TimerWheel &wheel)
+{
+    struct pollfd p;
+    p.fd = wheel.get_fd();
+    p.events = POLLIN;
+    int wakeups = 0;
+    while (wheel.size() > 0)
+    {
+        poll(&p, 1, -1);
+        wheel.expire();
+        wakeups++;
+    }
+    return wakeups;
+}
+
+// 大量定时器，取消一半，检查其余的恰好执行一次且不会提前
+void test_many()
+{
+    const int N = 200000;
+    TimerWheel wheel(1);
+    vector<int> fired(N, 0);
+    vector<uint64_t> deadline(N);
+    vector<TimerWheel::Handle> handles(N);
+    bool early = false;
+
+    mt19937 rng(1);
+    uint64_t start = now_ms();
+    for (int i = 0; i < N; i++)
+    {
+        uint64_t delay = rng() % 1500;
+        deadline[i] = start + delay;
+        handles[i] = wheel.schedule(delay, [&, i]()
+                                    {
+                                        fired[i]++;
+                                        if (now_ms() + 1 < deadline[i])
+                                            early = true;
+                                    });
+    }
+    for (int i = 0; i < N; i += 2)
+        assert(wheel.cancel(handles[i]));
+    assert(!wheel.cancel(handles[0]));
+    assert(wheel.size() == N / 2);
+
+    drive(wheel);
+    for (int i = 0; i < N; i++)
+        assert(fired[i] == i % 2);
+    assert(!early);
+
+    // 已执行的定时器不能再取消
+    assert(!wheel.cancel(handles[1]));
+    cout << "many timers success" << endl;
+}
+
+// 超过第0层范围的定时器经过上层降下来；timerfd只在槽降下来与到期时触发，不会每个tick触发
+// 之后添加的更早的定时器让timerfd提前触发
+void test_cascade()
+{
+    TimerWheel wheel(1);
+    int fired = 0;
+    uint64_t start = now_ms(), early_at = 0;
+    wheel.schedule(700, [&]()
+                   { fired++; });
+    wheel.schedule(5, [&]()
+                   { early_at = now_ms(); });
+    int wakeups = drive(wheel);
+    assert(fired == 1 && now_ms() - start >= 699);
+    assert(early_at >= start + 4 && early_at < start + 300);
+    assert(wakeups <= 6);
+    cout << "cascade success, " << wakeups << " wakeups" << endl;
+}
+
+// 周期定时器在回调中取消自己
+void test_periodic()
+{
+    TimerWheel wheel(1);
+    int fired = 0;
+    TimerWheel::Handle h;
+    h = wheel.schedule(5, [&]()
+                       {
+                           if (++fired == 5)
+                               assert(wheel.cancel(h));
+                       },
+                       5);
+    drive(wheel);
+    assert(fired == 5);
+    cout << "periodic success" << endl;
+}
+
+// 在监听器中使用，回调分别在事件循环与线程池中执行
+void test_listener(FilesListener &listener, const string &name)
+{
+    thread([&listener]()
+           { listener.listen(); })
+        .detach();
+
+    atomic<int> loop_fired{0}, pool_fired{0};
+    thread::id loop_thread;
+    listener.post([&]()
+                  {
+                      loop_thread = this_thread::get_id();
+                      listener.timers().schedule(20, [&]()
+                                                 {
+                                                     assert(this_thread::get_id() == loop_thread);
+                                                     loop_fired++;
+                                                 });
+                      listener.timers().schedule(20, [&]()
+                                                 { pool_fired++; },
+                                                 0, true);
+                  });
+
+    while (loop_fired.load() != 1 || pool_fired.load() != 1)
+        this_thread::sleep_for(chrono::milliseconds(1));
+    cout << name << " listener timers success" << endl;
+}
+
+int main()
+{
+    test_many();
+    test_cascade();
+    test_periodic();
+
+    FilesListenerEpoll epoll_listener(true);
+    test_listener(epoll_listener, "epoll");
+
+    FilesListenerSelect select_listener(false);
+    test_listener(select_listener, "select");
+
+    unique_ptr<FilesListenerUring> uring_listener;
+    if (FilesListenerUring::supported())
+    {
+        uring_listener.reset(new FilesListenerUring(true));
+        test_listener(*uring_listener, "uring");
+    }
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
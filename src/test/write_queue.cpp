@@ -0,0 +1,258 @@
+#include "src/fd/FIFOCache.h"
+#include "src/mux/FilesListenerEpoll.h"
+#include "src/mux/FilesListenerSelect.h"
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include <iostream>
+
+using namespace std;
+
+struct TestMsg
+{
+    int value;
+    char data[252];
+};
+
+const string DIR = "/tmp/fifo_framework_queue_";
+
+// 读出管道中的消息，检查按顺序从next开始，返回读到的数量
+int drain(ReadOnlyFIFO<TestMsg> &reader, int &next)
+{
+    int n = 0;
+    TestMsg msg;
+    while (reader.recv_msg(msg))
+    {
+        assert(msg.value == next);
+        next++;
+        n++;
+    }
+    return n;
+}
+
+// 读端不读时管道写满，之后的消息进入队列；读端开始读取后，监听器在可写时按顺序写出
+void test_queue(FilesListener &listener, const string &name, ReadOnlyFIFO<TestMsg> &reader)
+{
+    const int N = 1000;
+    FIFOCache cache(DIR, 4, N * sizeof(TestMsg));
+    cache.set_listener(&listener);
+    auto fifo = cache.get("0");
+
+    TestMsg msg;
+    for (int i = 0; i < N; i++)
+    {
+        msg.value = i;
+        assert(fifo->send(msg));
+    }
+    assert(fifo->queued_bytes() > 0);
+
+    int next = 0;
+    while (next < N)
+        if (drain(reader, next) == 0)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    assert(fifo->queued_bytes() == 0);
+    cout << name << " write queue success" << endl;
+}
+
+// 队列超过上限时丢弃，缓存重新打开管道，之后的消息可以继续发送
+void test_slow(ReadOnlyFIFO<TestMsg> &reader)
+{
+    FIFOCache cache(DIR, 4, 10 * sizeof(TestMsg));
+    auto fifo = cache.get("0");
+
+    TestMsg msg;
+    int sent = 0;
+    while (fifo->send(msg))
+        sent++;
+    assert(fifo->is_slow());
+    assert(!fifo->send(msg));
+
+    // 管道中的数据仍然完整
+    int next = 0;
+    while (reader.recv_msg(msg))
+        next++;
+    assert(next < sent);
+
+    auto reopened = cache.get("0");
+    assert(reopened != fifo && !reopened->is_slow());
+    msg.value = 0;
+    assert(reopened->send(msg));
+    next = 0;
+    assert(drain(reader, next) == 1);
+    cout << "write queue slow consumer success" << endl;
+}
+
+// 超过PIPE_BUF的消息写了一部分时队列超过上限，这条消息仍然写完，读端收到的都是完整的消息
+void test_slow_partial()
+{
+    struct BigMsg
+    {
+        int value;
+        char data[5000];
+    };
+    ReadOnlyFIFO<BigMsg> big_reader(DIR + "big");
+    big_reader.createfile();
+    big_reader.openfile();
+
+    FIFOCache cache(DIR, 4, 3 * sizeof(BigMsg));
+    auto fifo = cache.get("big");
+    BigMsg msg;
+    memset(msg.data, 0, sizeof(msg.data));
+    int sent = 0;
+    msg.value = sent;
+    while (fifo->send(msg))
+        msg.value = ++sent;
+    // 管道容量不是消息长度的整数倍，队首只写出了一部分
+    assert(fifo->queued_bytes() > 0 && fifo->queued_bytes() < sizeof(BigMsg));
+    assert(!fifo->is_slow());
+
+    // 超过PIPE_BUF的消息可能分几次读到，拼接后检查
+    string bytes;
+    int next = 0;
+    auto read_all = [&big_reader, &bytes, &next]()
+    {
+        char buf[65536];
+        int res;
+        while ((res = big_reader.readfile(buf, sizeof(buf))) > 0)
+            bytes.append(buf, res);
+        for (; bytes.size() >= sizeof(BigMsg); bytes.erase(0, sizeof(BigMsg)))
+        {
+            BigMsg got;
+            memcpy(&got, bytes.data(), sizeof(BigMsg));
+            assert(got.value == next++);
+        }
+    };
+    while (!fifo->is_slow())
+    {
+        read_all();
+        fifo->send(msg);
+    }
+    read_all();
+    assert(bytes.empty());
+    assert(next > 0 && next < sent);
+
+    auto reopened = cache.get("big");
+    assert(reopened != fifo);
+    msg.value = 12345;
+    assert(reopened->send(msg));
+    next = 12345;
+    read_all();
+    assert(next == 12346 && bytes.empty());
+
+    big_reader.closefile();
+    big_reader.deletefile();
+    cout << "write queue slow consumer partial message success" << endl;
+}
+
+// 删除后发送队列写完才关闭（比如登出的回复）；写完之前再次取出时继续使用同一个管道
+void test_evict(FilesListener &listener, ReadOnlyFIFO<TestMsg> &reader)
+{
+    const int N = 1000;
+    FIFOCache cache(DIR, 4, N * sizeof(TestMsg));
+    cache.set_listener(&listener);
+    weak_ptr<ReplyFIFO> weak;
+    {
+        auto fifo = cache.get("0");
+        weak = fifo;
+        TestMsg msg;
+        for (int i = 0; i < N / 2; i++)
+        {
+            msg.value = i;
+            assert(fifo->send(msg));
+        }
+        assert(fifo->queued_bytes() > 0);
+        assert(cache.evict("0"));
+    }
+    // 取回时队列还没写完
+    auto again = cache.get("0");
+    assert(again == weak.lock());
+    TestMsg msg;
+    for (int i = N / 2; i < N; i++)
+    {
+        msg.value = i;
+        assert(again->send(msg));
+    }
+    assert(cache.evict("0"));
+    again.reset();
+    assert(!weak.expired());
+
+    int next = 0;
+    while (next < N)
+        if (drain(reader, next) == 0)
+            this_thread::sleep_for(chrono::milliseconds(1));
+    while (!weak.expired())
+        this_thread::sleep_for(chrono::milliseconds(1));
+    cout << "write queue evict after flush success" << endl;
+}
+
+// 读端一直不读时，删除的管道在超时后丢弃队列并关闭
+void test_evict_timeout(FilesListener &listener, ReadOnlyFIFO<TestMsg> &reader)
+{
+    FIFOCache cache(DIR, 4, 262144, 0, 50);
+    cache.set_listener(&listener);
+    weak_ptr<ReplyFIFO> weak;
+    {
+        auto fifo = cache.get("0");
+        weak = fifo;
+        TestMsg msg;
+        while (fifo->queued_bytes() == 0)
+            assert(fifo->send(msg));
+        cache.evict("0");
+    }
+    assert(!weak.expired());
+    while (!weak.expired())
+        this_thread::sleep_for(chrono::milliseconds(1));
+
+    // 读走管道中已写入的消息
+    int n = 0;
+    TestMsg msg;
+    while (reader.recv_msg(msg))
+        n++;
+    assert(n > 0);
+    cout << "write queue evict timeout success" << endl;
+}
+
+// 打开后设置管道容量
+void test_pipe_size()
+{
+    FIFOCache cache(DIR, 4, 262144, 1 << 20);
+    auto fifo = cache.get("0");
+    assert(fcntl(fifo->get_fd(), F_GETPIPE_SZ) == 1 << 20);
+    cout << "write queue pipe size success" << endl;
+}
+
+int main()
+{
+    ReadOnlyFIFO<TestMsg> reader(DIR + "0");
+    reader.createfile();
+    reader.openfile();
+
+    test_slow(reader);
+    test_slow_partial();
+
+    FilesListenerEpoll epoll_listener(false);
+    thread([&epoll_listener]()
+           { epoll_listener.listen(); })
+        .detach();
+    test_queue(epoll_listener, "epoll", reader);
+    test_evict(epoll_listener, reader);
+    test_evict_timeout(epoll_listener, reader);
+
+    // 不支持等待可写的监听器按定时器重试
+    FilesListenerSelect select_listener(false);
+    thread([&select_listener]()
+           { select_listener.listen(); })
+        .detach();
+    test_queue(select_listener, "select", reader);
+
+    // 管道容量在读端关闭前一直有效，最后测试
+    test_pipe_size();
+
+    reader.closefile();
+    reader.deletefile();
+
+    // 监听线程不会退出，直接结束进程
+    cout << flush;
+    _exit(0);
+}
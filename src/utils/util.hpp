@@ -73,6 +73,16 @@ namespace UtilError
 
 namespace UtilSystem
 {
+    // 忙等循环中提示CPU正在自旋，降低功耗并让出流水线给同核的其他超线程
+    static inline void cpu_relax()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
     // 变身守护进程
     static int init_daemon()
     {